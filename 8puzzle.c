@@ -3,524 +3,413 @@
 //
 
 #include <stdio.h>
-#include <malloc.h>
+#include <stdlib.h>
 #include <string.h>
-#include <time.h>
-#include <math.h>
-#include <ctype.h>
-#include <stdint.h>
-
-#define SIZE 9
-#define ROWS 3
-#define tile char
-#define NEIGHBOR_CNT 4
-#define LONGEST_SOL 32
-#define CHILD_CNT 4
-#define LF_THRESHOLD 0.7f
+#include <unistd.h>
+#include <signal.h>
+#include "solver.h"
+#include "trace.h"
+#include "pipeline.h"
 
 // TYPE AND FUNCTION DEFINITIONS
 
-typedef enum move {
-    NONE, UP, DOWN, LEFT, RIGHT
-} move;
+void print_stats(const solve_stats*);
 
-typedef tile board[SIZE];
-
-typedef struct puzzle {
-    struct puzzle* parent;
-    board board;
-    move move;
-    int g;
-    int f;
-} puzzle;
-
-typedef struct priority_q {
-    puzzle** min_heap;
-    int size;
-    int capacity;
-} priority_q;
-
-typedef struct hash_table {
-    int* table;
-    int size;
-    int capacity;
-} hash_table;
-
-typedef struct list {
-    puzzle** arr;
-    int size;
-    int capacity;
-} list;
-
-list* new_list();
-
-void push_list(list* ls, puzzle*);
-
-hash_table* new_ht();
-
-int hash_board(const board);
-
-void rehash(hash_table*);
-
-int probe(hash_table*, int, int);
-
-void insert_into_ht(hash_table* ht, int key);
-
-void probe_ht(hash_table* ht, int key);
-
-int ht_has_key(hash_table* ht, int key);
-
-int is_prime(int);
-
-int next_prime(int);
-
-priority_q* new_pq();
-
-void ensure_capacity(priority_q*);
-
-void push_pq(priority_q*, puzzle*);
-
-puzzle* pop_pq(priority_q*);
-
-puzzle* new_puzzle(const board);
-
-int find_zero(const board);
-
-int move_board(board brd_in, board brd_out, int row_offset, int col_offset);
-
-int heuristic(const board);
-
-void solve(const board, const board);
+void print_report(const solve_report*, const solve_stats*);
 
 void print_board(const board);
 
-void reconstruct_path(puzzle*);
+int print_move(move mv, const board brd, void* user);
 
-void parse_board(board brd, FILE* input_file);
+uint8_t* get_distance_table(const board goal_brd, const char* table_path);
+
+void handle_interrupt(int);
 
 // GLOBALS
 
-static const int NEIGHBOR_OFFSETS[NEIGHBOR_CNT][2] = {{0, 1}, {1, 0}, {0, -1}, {-1, 0}};
-static const int NEIGHBOR_MOVES[NEIGHBOR_CNT] = {RIGHT, DOWN, LEFT, UP};
-static const char* MOVE_STRINGS[] = {"Start", "Up", "Down", "Left", "Right"};
+static cancel_token* interrupt_token;
 
-// LIST IMPLEMENTATION
+// OUTPUT IMPLEMENTATION
 
-list* new_list() {
-    list* ls = malloc(sizeof(list));
-    ls->size = 0;
-    ls->capacity = 10;
-    ls->arr = malloc(sizeof(puzzle*) * ls->capacity);
-    if (ls == NULL && ls->arr == NULL) {
-        printf("Failed to allocate list");
-        exit(1);
+void print_stats(const solve_stats* stats) {
+    printf("Expanded %ld states, generated %ld states, %ld allocations\n", stats->expanded, stats->generated,
+           stats->allocations);
+    printf("Algorithm: %s\n", algorithm_name(stats->algorithm));
+    if (stats->predicted >= 0) {
+        printf("Predicted expansions: %ld, error %+.1f%%\n", stats->predicted, stats->prediction_error * 100);
     }
-    return ls;
-}
-
-void push_list(list* ls, puzzle* puz) {
-    // add to block of all puzzles
-    if (ls->size >= ls->capacity) {
-        ls->capacity = ls->capacity * 2;
-        ls->arr = realloc(ls->arr, sizeof(puzzle*) * ls->capacity);
-        if (ls->arr == NULL) {
-            printf("Failed to reallocate list");
-            exit(1);
-        }
+    printf("%-12s %14s %14s\n", "memory", "current bytes", "peak bytes");
+    printf("%-12s %14zu %14zu\n", "puzzles", stats->puzzles.current, stats->puzzles.peak);
+    printf("%-12s %14zu %14zu\n", "open_set", stats->open_set.current, stats->open_set.peak);
+    printf("%-12s %14zu %14zu\n", "closed_set", stats->closed_set.current, stats->closed_set.peak);
+    printf("%-12s %14zu %14zu\n", "pruner", stats->pruner.current, stats->pruner.peak);
+    printf("%-12s %14zu %14zu\n", "total", stats->total.current, stats->total.peak);
+    printf("Pages: %s\n", page_mode_name(stats->pages));
+    if (stats->numa_node >= 0) {
+        printf("NUMA node: %d\n", stats->numa_node);
     }
-    ls->arr[ls->size] = puz;
-    ls->size++;
-}
-
-// HASH TABLE IMPLEMENTATION
-
-hash_table* new_ht() {
-    hash_table* ht = malloc(sizeof(hash_table));
-    ht->capacity = next_prime(10);
-    ht->table = calloc(ht->capacity, sizeof(int));
-    ht->size = 0;
-    if (ht == NULL || ht->table == NULL) {
-        printf("Failed to allocate hash_table");
-        exit(1);
+    if (stats->node_loads >= 0) {
+        printf("Loads served from memory: %ld, %ld from a remote node\n", stats->node_loads, stats->remote_loads);
     }
-    return ht;
-}
-
-int hash_board(const board board) {
-    // hash function takes each symbol in the puzzle from start to end as a digit
-    int hash = 0;
-    for (int i = 0; i < SIZE; i++) {
-        hash += board[i] * (int) pow(10, i);
-    }
-    return hash;
-}
-
-int probe(hash_table* ht, int h, int i) {
-    return (h + i) % ht->capacity; // linear probe
+    printf("\n");
 }
 
-void rehash(hash_table* ht) {
-    // keep references to old structures before creating new structures
-    int old_capacity = ht->capacity;
-    int* old_table = ht->table;
-    // allocate a new hash table and rehash all old elements into it
-    ht->capacity = next_prime(ht->capacity * 2);
-    ht->table = calloc(ht->capacity, sizeof(int));
-    // check for allocation errors
-    if (ht->table == NULL) {
-        printf("hash_table reallocation failed");
-        exit(1);
-    }
-    // add all keys from the old to the new min_heap
-    for (int i = 0; i < old_capacity; i++) {
-        if (old_table[i] != 0) {
-            probe_ht(ht, old_table[i]);
+void print_board(const board brd) {
+    for (int i = 0; i < PUZZLE_SIZE; i++) {
+        if (brd[i] != 0) {
+            printf("%d ", brd[i]);
+        } else {
+            printf("  ");
+        }
+        if ((i + 1) % 3 == 0) {
+            printf("\n");
         }
     }
-    // free the old hash table
-    free(old_table);
+    printf("\n");
 }
 
-void insert_into_ht(hash_table* ht, int key) {
-    // rehash when load factor exceeds threshold
-    if ((float) ht->size / (float) ht->capacity > LF_THRESHOLD) {
-        rehash(ht);
-    }
-    probe_ht(ht, key);
-    ht->size++;
+int print_move(move mv, const board brd, void* user) {
+    (void) user;
+    printf("%s\n", move_name(mv));
+    print_board(brd);
+    return 0;
 }
 
-void probe_ht(hash_table* ht, int key) {
-    // probe until we find a slot to insert
-    for (int i = 0;; i++) {
-        int p = probe(ht, key, i);
-        if (ht->table[p] == 0) {
-            ht->table[p] = key;
-            break;
+void print_report(const solve_report* report, const solve_stats* stats) {
+    printf("%-8s %12s\n", "f", "expanded");
+    for (int i = 0; i < PUZZLE_REPORT_MAX; i++) {
+        if (report->expanded_by_f[i] > 0) {
+            printf("%-8d %12ld\n", i, report->expanded_by_f[i]);
         }
     }
-}
-
-int ht_has_key(hash_table* ht, int key) {
-    // probe until we find a match or the first empty slot
-    for (int i = 0;; i++) {
-        int p = probe(ht, key, i);
-        if (ht->table[p] == 0) {
-            // probed until empty slot so board isn't in table
-            return 0;
-        } else if (ht->table[p] == key) {
-            // hash values match so board is in table
-            return 1;
+    printf("\n%-8s %12s\n", "g", "expanded");
+    for (int i = 0; i < PUZZLE_REPORT_MAX; i++) {
+        if (report->expanded_by_g[i] > 0) {
+            printf("%-8d %12ld\n", i, report->expanded_by_g[i]);
         }
     }
-}
-
-int is_prime(int n) {
-    // iterate from 2 to sqrt(n)
-    for (int i = 2; i <= sqrt(n); i++) {
-        // if n is divisible by any number between 2 and n/2, it is not prime
-        if (n % i == 0) {
-            return 0;
+    if (report->samples > 0) {
+        printf("\nHeuristic error (true distance - h) over %ld expanded states\n", report->samples);
+        printf("mean %.3f, max %d, min %d\n", (double) report->error_sum / (double) report->samples,
+               report->max_error, report->min_error);
+        printf("%-8s %12s\n", "error", "states");
+        for (int i = 0; i < 2 * PUZZLE_REPORT_MAX; i++) {
+            if (report->error_cnt[i] > 0) {
+                printf("%-8d %12ld\n", i - PUZZLE_REPORT_MAX, report->error_cnt[i]);
+            }
         }
     }
-    if (n <= 1)
-        return 0;
-    return 1;
+    printf("\nEffective branching factor: %.4f\n\n", branching_factor(stats->expanded, stats->steps));
 }
 
-int next_prime(int n) {
-    for (int i = n;; i++) {
-        if (is_prime(i)) {
-            return i;
+uint8_t* get_distance_table(const board goal_brd, const char* table_path) {
+    // load a saved table if there is one, otherwise build it and save it for the next run
+    FILE* table_file = table_path != NULL ? fopen(table_path, "rb") : NULL;
+    if (table_file != NULL) {
+        uint8_t* distances = load_distance_table(table_file);
+        fclose(table_file);
+        if (distances != NULL) {
+            return distances;
         }
     }
-}
-
-// PQ IMPLEMENTATION
-
-priority_q* new_pq() {
-    priority_q* pq = malloc(sizeof(priority_q));
-    pq->capacity = 10;
-    pq->min_heap = malloc(sizeof(puzzle) * pq->capacity);
-    pq->size = 0;
-    if (pq == NULL || pq->min_heap == NULL) {
-        printf("Failed to allocate priority_q");
-        exit(1);
+    uint8_t* distances = new_distance_table(goal_brd);
+    if (distances != NULL && table_path != NULL && (table_file = fopen(table_path, "wb")) != NULL) {
+        save_distance_table(distances, table_file);
+        fclose(table_file);
     }
-    return pq;
+    return distances;
 }
 
-void ensure_capacity(priority_q* pq) {
-    // ensure min_heap's capacity is large enough
-    if (pq->size >= pq->capacity) {
-        pq->capacity = pq->capacity * 2;
-        pq->min_heap = realloc(pq->min_heap, sizeof(puzzle) * pq->capacity);
-        // check for allocation errors
-        if (pq->min_heap == NULL) {
-            printf("priority_q reallocation failed");
-            exit(1);
-        }
+void finish_trace(trace_writer* tw) {
+    long dropped = tw != NULL ? close_trace(tw) : 0;
+    if (dropped > 0) {
+        printf("Trace dropped %ld events on full buffers\n", dropped);
     }
 }
 
-void push_pq(priority_q* pq, puzzle* puz) {
-    ensure_capacity(pq);
-    // add element to end of min_heap
-    pq->min_heap[pq->size] = puz;
-    // sift the min_heap up
-    int pos = pq->size;
-    int parent = (pos - 1) / CHILD_CNT;
-    // sift up until parent score is larger
-    while (parent >= 0) {
-        if (pq->min_heap[pos]->f < pq->min_heap[parent]->f) {
-            // swap parent with child
-            puzzle* temp = pq->min_heap[pos];
-            pq->min_heap[pos] = pq->min_heap[parent];
-            pq->min_heap[parent] = temp;
-            // climb up the tree
-            pos = parent;
-            parent = (pos - 1) / CHILD_CNT;
-        } else {
-            parent = -1;
-        }
-    }
-    pq->size++;
+void handle_interrupt(int sig) {
+    (void) sig;
+    cancel_solve(interrupt_token);
 }
 
-puzzle* pop_pq(priority_q* pq) {
-    // check for empty min_heap
-    if (pq->size == 0) {
-        printf("Can't pop an empty min_heap");
-        exit(1);
-    }
-    // extract top element and move bottom to top
-    puzzle* top = pq->min_heap[0];
-    pq->min_heap[0] = pq->min_heap[pq->size - 1];
-    // sift top element down
-    int pos = 0;
-    for (;;) {
-        // get the smallest child
-        int first_child = CHILD_CNT * pos + 1;
-        int child = first_child;
-        if (child >= pq->size) {
-            break;
-        }
-        // iterate from leftmost to rightmost child to find the smallest at level
-        for (int i = 1; i < CHILD_CNT; i++) {
-            int new_child = first_child + i;
-            if (new_child >= pq->size) {
-                break;
+int main(int argc, char** argv) {
+    char* file_path = NULL;
+    char* trace_path = NULL;
+    char* table_path = NULL;
+    char* batch_path = NULL;
+    char* output_path = NULL;
+    size_t mem_limit = 0;
+    long timeout_ms = 0;
+    solve_heuristic heuristic = MANHATTAN;
+    solve_algorithm algorithm = ASTAR;
+    solve_pruning pruning = PRUNE_FSM;
+    solve_isa isa = detect_isa();
+    int bench = 0;
+    int huge_pages = 0;
+    int show_stats = 0;
+    int show_report = 0;
+    int validate = 0;
+    int use_uring = 0;
+    batch_dispatch dispatch = DISPATCH_LPT;
+    worker_opts workers = {0};
+    workers.thread_cnt = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    workers.policy = POLICY_OTHER;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            bench = 1;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            show_stats = 1;
+        } else if (strcmp(argv[i], "--huge-pages") == 0) {
+            huge_pages = 1;
+        } else if (strcmp(argv[i], "--numa") == 0) {
+            workers.numa = 1;
+        } else if (strcmp(argv[i], "--counters") == 0) {
+            workers.counters = 1;
+        } else if (strcmp(argv[i], "--validate") == 0) {
+            validate = 1;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            workers.thread_cnt = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cpus") == 0 && i + 1 < argc) {
+            if ((workers.cpu_cnt = parse_cpus(argv[++i], workers.cpus, MAX_CPUS)) < 0) {
+                printf("Malformed cpu list %s", argv[i]);
+                return 1;
             }
-            if(pq->min_heap[new_child]->f < pq->min_heap[child]->f) {
-                child = new_child;
+        } else if (strcmp(argv[i], "--io-cpus") == 0 && i + 1 < argc) {
+            if ((workers.io_cpu_cnt = parse_cpus(argv[++i], workers.io_cpus, MAX_CPUS)) < 0) {
+                printf("Malformed cpu list %s", argv[i]);
+                return 1;
             }
-        }
-        // swap child with parent if child is smaller
-        if (pq->min_heap[pos]->f > pq->min_heap[child]->f) {
-            // swap parent with child
-            puzzle* temp = pq->min_heap[pos];
-            pq->min_heap[pos] = pq->min_heap[child];
-            pq->min_heap[child] = temp;
-            // climb down tree
-            pos = child;
+        } else if (strcmp(argv[i], "--sched") == 0 && i + 1 < argc) {
+            if (parse_thread_policy(argv[++i], &workers.policy) != 0) {
+                printf("Scheduling policy %s is unknown", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--priority") == 0 && i + 1 < argc) {
+            workers.priority = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--report") == 0) {
+            show_report = 1;
+        } else if (strcmp(argv[i], "--mem-limit") == 0 && i + 1 < argc) {
+            // limit is given in megabytes
+            mem_limit = strtoull(argv[++i], NULL, 10) * 1024 * 1024;
+        } else if (strcmp(argv[i], "--heuristic") == 0 && i + 1 < argc) {
+            if (parse_heuristic(argv[++i], &heuristic) != 0) {
+                printf("Heuristic %s is unknown, expected manhattan or misplaced", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--algorithm") == 0 && i + 1 < argc) {
+            if (parse_algorithm(argv[++i], &algorithm) != 0) {
+                printf("Algorithm %s is unknown", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--pruning") == 0 && i + 1 < argc) {
+            if (parse_pruning(argv[++i], &pruning) != 0) {
+                printf("Pruning %s is unknown, expected none, inverse or fsm", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--force-isa") == 0 && i + 1 < argc) {
+            if (parse_isa(argv[++i], &isa) != 0 || !isa_supported(isa)) {
+                printf("Instruction set %s is unknown or not supported by this cpu", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            timeout_ms = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_path = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (strcmp(argv[i], "--uring") == 0) {
+            use_uring = 1;
+        } else if (strcmp(argv[i], "--dispatch") == 0 && i + 1 < argc) {
+            if (parse_dispatch(argv[++i], &dispatch) != 0) {
+                printf("Dispatch order %s is unknown, expected lpt or input", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--table") == 0 && i + 1 < argc) {
+            table_path = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
         } else {
-            break;
+            file_path = argv[i];
         }
     }
-    pq->size--;
-    return top;
-}
 
-// PUZZLE SOLVER IMPLEMENTATION
-
-puzzle* new_puzzle(const board brd) {
-    puzzle* puz = malloc(sizeof(puzzle));
-    if (puz == NULL) {
-        printf("Failed to allocate puzzle");
-        exit(1);
+    if (bench) {
+        return run_benches(isa);
     }
-    memcpy(puz->board, brd, sizeof(board));
-    puz->move = NONE;
-    puz->parent = NULL;
-    puz->f = 0;
-    puz->g = 0;
-    return puz;
-}
-
-int find_zero(const board brd) {
-    for (int i = 0; i < SIZE; i++)
-        if (brd[i] == 0)
-            return i;
-    printf("board doesn't contain 0");
-    exit(1);
-}
 
-int move_board(board brd_in, board brd_out, int row_offset, int col_offset) {
-    // copy input to output (overrides output board)
-    memcpy(brd_out, brd_in, sizeof(board));
-    // find the location of the zero on the board
-    int zero_loc = find_zero(brd_in);
-    int zero_row = zero_loc / ROWS;
-    int zero_col = zero_loc % ROWS;
-    // find the location of the tile to be swapped
-    int swap_row = zero_row + row_offset;
-    int swap_col = zero_col + col_offset;
-    int swap_loc = swap_col + ROWS * swap_row;
-    // check if puzzle is out of bounds
-    if (swap_row < 0 || swap_row >= ROWS || swap_col < 0 || swap_col >= ROWS) {
-        return 1;
-    }
-    // swap location of 0 with new location
-    tile temp = brd_out[zero_loc];
-    brd_out[zero_loc] = brd_out[swap_loc];
-    brd_out[swap_loc] = temp;
-    return 0;
-}
-
-int heuristic(const board brd) {
-    int h = 0;
-    for (int i = 0; i < SIZE; i++) {
-        // manhattan distance
-        int row1 = i / ROWS;
-        int col1 = i % ROWS;
-        int row2 = brd[i] / SIZE;
-        int col2 = brd[i] % SIZE;
-        h += abs(row2 - row1) + abs(col2 - col1);
-    }
-    return h;
-}
-
-void solve(const board initial_brd, const board goal_brd) {
-    int goal_hash = hash_board(goal_brd);
-
-    list* puzzles = new_list();
-    puzzle* root = new_puzzle(initial_brd);
-    priority_q* open_set = new_pq();
-    hash_table* closed_set = new_ht();
-
-    push_list(puzzles, root);
-    push_pq(open_set, root);
-
-    // iterate until we find a solution
-    while(open_set->size >= 0) {
-        // pop off the state with the best heuristic
-        puzzle* current_puz = pop_pq(open_set);
-        int current_hash = hash_board(current_puz->board);
-        insert_into_ht(closed_set, current_hash);
-
-        // check if we've reached the goal state
-        if (current_hash == goal_hash) {
-            // print out solution
-            reconstruct_path(current_puz);
-            break;
-        }
+    board goal_brd = {1, 2, 3, 4, 5, 6, 7, 8, 0};
 
-        // add neighbor states to the priority queue
-        for (int i = 0; i < NEIGHBOR_CNT; i++) {
-            board neighbor_board = {0};
-            int row_offset = NEIGHBOR_OFFSETS[i][0];
-            int col_offset = NEIGHBOR_OFFSETS[i][1];
-            // write a moved board state into the neighbor board, then check for error states and if neighbor bord is closed
-            if (move_board(current_puz->board, neighbor_board, row_offset, col_offset) == 0
-                && !ht_has_key(closed_set, hash_board(neighbor_board))) {
-
-                // create a new neighbor with the new board and calculated states
-                puzzle* neighbor_puz = new_puzzle(neighbor_board);
-                neighbor_puz->parent = current_puz;
-                neighbor_puz->g = current_puz->g + 1;
-                neighbor_puz->f = neighbor_puz->g + heuristic(neighbor_board);
-                neighbor_puz->move = NEIGHBOR_MOVES[i];
-
-                // add to list of all puzzles
-                push_list(puzzles, neighbor_puz);
-
-                // add neighbor board to pq
-                push_pq(open_set, neighbor_puz);
-            }
+    // every solving thread traces into a buffer of its own, numbered by worker
+    trace_writer* tw = NULL;
+    if (trace_path != NULL) {
+        tw = open_trace(trace_path);
+        if (tw == NULL) {
+            printf("Failed to open trace file %s", trace_path);
+            return 1;
         }
     }
 
-    // free all puzzles stored in list
-    for (int i = 0; i < puzzles->size; i++) {
-        free(puzzles->arr[i]);
-    }
-
-    free(puzzles->arr);
-    free(puzzles);
-    free(closed_set->table);
-    free(closed_set);
-    free(open_set->min_heap);
-    free(open_set);
-}
+    // once the trace is open every exit goes through cleanup, so it is always flushed and closed
+    int exit_code = 1;
+    solver_ctx* ctx = NULL;
+    uint8_t* distances = NULL;
+    solve_report* report = NULL;
 
-void print_board(const board brd) {
-    for (int i = 0; i < SIZE; i++) {
-        if (brd[i] != 0) {
-            printf("%d ", brd[i]);
-        } else {
-            printf("  ");
+    if (validate) {
+        if ((distances = get_distance_table(goal_brd, table_path)) == NULL) {
+            printf("Failed to allocate the distance table");
+            goto cleanup;
         }
-        if ((i + 1) % 3 == 0) {
-            printf("\n");
+        if (workers.thread_cnt <= 0) {
+            workers.thread_cnt = 1;
         }
+        exit_code = run_validation(goal_brd, distances, algorithm, pruning, &workers, tw);
+        goto cleanup;
     }
-    printf("\n");
-}
-
-void reconstruct_path(puzzle* leaf_puz) {
-    int count;
-    puzzle* path[LONGEST_SOL];
-    for(count = 0; leaf_puz != NULL; count++) {
-        path[count] = leaf_puz;
-        leaf_puz = leaf_puz->parent;
-    }
-    for (int i = count - 1; i >= 0; i--) {
-        printf("%s\n", MOVE_STRINGS[path[i]->move]);
-        print_board(path[i]->board);
-    }
-    printf("Solved in %d steps\n", count - 1);
-}
 
-void parse_board(board brd, FILE* input_file) {
-    int count = 0;
-    for (;;) {
-        char c = (char) fgetc(input_file);
-        if (c == EOF)
-            break;
-        if(isdigit(c)) {
-            int symbol = c - '0';
-            brd[count] = (char) symbol;
-            count++;
+    if (batch_path != NULL) {
+        batch_opts batch = {batch_path, output_path, algorithm, pruning, heuristic, timeout_ms, use_uring, dispatch, NULL, tw};
+        if (workers.thread_cnt <= 0) {
+            workers.thread_cnt = 1;
         }
+        // the true distances rank boards better than the heuristic and solve them with a table lookup, but building
+        // them is only worth it for a table file or when the lookup is asked for
+        if ((table_path != NULL || algorithm == TABLE_LOOKUP)
+            && (distances = get_distance_table(goal_brd, table_path)) == NULL) {
+            printf("Failed to allocate the distance table");
+            goto cleanup;
+        }
+        batch.distances = distances;
+        exit_code = run_batch(goal_brd, &batch, &workers);
+        goto cleanup;
     }
-    if (count < 9) {
-        printf("An input board's size must be 9.");
-        exit(1);
-    }
-}
 
-int main(int argc, char** argv) {
-    if (argc <= 1) {
-        printf("First argument must be input file.");
-        return 1;
+    if (file_path == NULL) {
+        printf("Usage: 8puzzle [--stats] [--report] [--mem-limit MB] [--huge-pages] [--numa] [--counters] [--cpus LIST]"
+               " [--sched POLICY] [--priority N] [--timeout MS] [--heuristic manhattan|misplaced]"
+               " [--algorithm astar|idastar|table|auto] [--pruning none|inverse|fsm] [--force-isa ISA] [--table FILE] [--trace FILE]"
+               " <input file>"
+               " | --bench [--force-isa ISA]"
+               " | --validate [--threads N] [--numa] [--counters] [--cpus LIST] [--io-cpus LIST] [--sched POLICY] [--priority N]"
+               " [--algorithm A] [--pruning P] [--table FILE] [--trace FILE]"
+               " | --batch FILE [--output FILE] [--uring] [--dispatch lpt|input] [--table FILE] [--threads N] [--cpus LIST] [--io-cpus LIST] [--algorithm A] [--timeout MS] [--trace FILE]");
+        goto cleanup;
     }
 
-    char* file_path = argv[1];
     FILE* input_file = fopen(file_path, "r");
+    if (input_file == NULL) {
+        printf("Failed to open %s", file_path);
+        goto cleanup;
+    }
 
     board initial_brd = {0};
-    parse_board(initial_brd, input_file);
+    int parse_err = parse_board(initial_brd, input_file);
+    fclose(input_file);
+    if (parse_err) {
+        printf("An input board must hold each tile from 0 to 8 once.");
+        goto cleanup;
+    }
 
-    board goal_brd = {1, 2, 3, 4, 5, 6, 7, 8, 0};
+    ctx = new_solver(mem_limit);
+    interrupt_token = new_cancel_token();
+    if (ctx == NULL || interrupt_token == NULL) {
+        printf("Failed to allocate the solver");
+        goto cleanup;
+    }
+    set_solver_heuristic(ctx, heuristic);
+    set_solver_algorithm(ctx, algorithm);
+    set_solver_pruning(ctx, pruning);
+    set_solver_isa(ctx, isa);
+    if (huge_pages && set_solver_huge_pages(ctx, 1) != 0) {
+        printf("Failed to allocate the solver");
+        goto cleanup;
+    }
+    // the main thread is the only worker, it runs on the cpu list when one is given
+    if (workers.cpu_cnt > 0 && pin_to_cpus(workers.cpus, workers.cpu_cnt) != 0) {
+        printf("Failed to pin the solver to the cpu list");
+        goto cleanup;
+    }
+    if (workers.policy != POLICY_OTHER && set_thread_policy(workers.policy, workers.priority) != 0) {
+        printf("Failed to set the scheduling policy, the real time ones need CAP_SYS_NICE");
+        goto cleanup;
+    }
+    // stay on the node the process started on, so the search and its memory don't end up on different sockets
+    int node = current_numa_node();
+    if (workers.numa && (pin_to_numa_node(node) != 0 || set_solver_numa_node(ctx, node) != 0)) {
+        printf("Failed to place the solver on NUMA node %d", node);
+        goto cleanup;
+    }
+    if (workers.counters && set_solver_counters(ctx, 1) != 0) {
+        printf("Hardware counters are unavailable\n");
+    }
+    set_solver_timeout(ctx, timeout_ms);
+    // ctrl-c stops the search cleanly instead of killing the process
+    set_solver_cancel(ctx, interrupt_token);
+    signal(SIGINT, handle_interrupt);
+
+    // the report measures h against the BFS table and the table lookup walks it, built before timing starts
+    int walk = algorithm == TABLE_LOOKUP || (algorithm == AUTO_SELECT && table_path != NULL);
+    if ((show_report || walk) && (distances = get_distance_table(goal_brd, table_path)) == NULL) {
+        printf("Failed to allocate the distance table");
+        goto cleanup;
+    }
+    set_solver_table(ctx, walk ? distances : NULL);
+    if (show_report) {
+        report = calloc(1, sizeof(solve_report));
+        if (report == NULL) {
+            printf("Failed to allocate the report");
+            goto cleanup;
+        }
+        report->distances = distances;
+    }
 
     printf("Starting...\n\n");
 
-    clock_t tic = clock();
-
-    solve(initial_brd, goal_brd);
-
-    clock_t toc = clock() - tic;
-    printf("Total execution time: %d ms", (int) toc);
+    double start = now_ns();
+
+    solve_stats stats;
+    set_solver_trace(ctx, trace_thread(tw, 0));
+    set_solver_report(ctx, report);
+    solve_status status = solve(ctx, initial_brd, goal_brd, NULL, &stats);
+
+    double elapsed_ms = (now_ns() - start) / 1e6;
+
+    if (status == SOLVED) {
+        printf("%s\n", move_name(NONE));
+        print_board(initial_brd);
+        stream_path(ctx, print_move, NULL);
+        printf("Solved in %d steps\n", stats.steps);
+    } else if (status == UNSOLVABLE) {
+        printf("Board is unsolvable\n");
+    } else if (status == OUT_OF_MEMORY) {
+        printf("Memory limit exceeded, aborted the solve\n");
+    } else if (status == TIMED_OUT || status == CANCELLED) {
+        printf("%s after %ld expansions, f bound %d, best h %d\n", status == TIMED_OUT ? "Timed out" : "Cancelled",
+               stats.expanded, stats.f_bound, stats.best_h);
+    }
+    // always show where the memory went when a solve runs out of it
+    if (show_stats || status == OUT_OF_MEMORY) {
+        printf("Heuristic kernel: %s\n", isa_name(solver_isa(ctx)));
+        print_stats(&stats);
+    }
+    if (report != NULL) {
+        print_report(report, &stats);
+    }
+    printf("Total execution time: %.0f ms\n", elapsed_ms);
+    exit_code = (int) status;
 
-    return 0;
+cleanup:
+    if (ctx != NULL) {
+        free_solver(ctx);
+    }
+    if (interrupt_token != NULL) {
+        free_cancel_token(interrupt_token);
+    }
+    if (distances != NULL) {
+        free_distance_table(distances);
+    }
+    free(report);
+    finish_trace(tw);
+    return exit_code;
 }
@@ -0,0 +1,144 @@
+//
+// Joseph Prichard 2023
+//
+
+// A* search loop instantiated once per combination of policies. Define these before including it:
+//   ENGINE_STEP                       name of the generated step function
+//   ENGINE_STATE_KEY(brd)             key identifying a board in the closed set
+//   ENGINE_HEURISTIC(ctx, brd)        admissible estimate of the distance to the goal
+//   ENGINE_OPEN_PUSH(ctx, node, f)    push a node index onto the open list, nonzero if out of memory
+//   ENGINE_OPEN_POP(ctx)              pop the node with the lowest f
+//   ENGINE_OPEN_SIZE(ctx)
+//   ENGINE_CLOSED_INSERT(ctx, key)    insert into the closed set, nonzero if out of memory
+//   ENGINE_CLOSED_HAS(ctx, key)
+//   ENGINE_CLOSED_PREFETCH(ctx, key)  hint that key is about to be looked up
+//   ENGINE_CLOSED_SIZE(ctx)
+// Every policy is a macro expanding to a direct call, so the compiler sees through all of them in the loop.
+
+solve_status ENGINE_STEP(solver_ctx* ctx, long max_expansions) {
+    node_store* nodes = ctx->nodes;
+    trace_buffer* trace = ctx->trace;
+    solve_report* report = ctx->report;
+    solve_stats* stats = &ctx->stats;
+    int prune_inverse = ctx->pruning != PRUNE_NONE;
+    solve_status status = ctx->status;
+    if (status != IN_PROGRESS) {
+        return status;
+    }
+    trace_begin(trace, "search");
+
+    // iterate until we find a solution, run out of states or use up this slice
+    for (long n = 0; status == IN_PROGRESS && n < max_expansions; n++) {
+        if (ENGINE_OPEN_SIZE(ctx) == 0) {
+            status = UNSOLVABLE;
+            break;
+        }
+        // poll every so often, reading the clock on every expansion would show up in profiles
+        if ((stats->expanded & CANCEL_CHECK_MASK) == 0 && (status = poll_cancel(ctx, ctx->deadline)) != IN_PROGRESS) {
+            break;
+        }
+        // pop off the state with the best heuristic
+        int current = ENGINE_OPEN_POP(ctx);
+        // read the node's columns out once, the store may move as neighbors are added
+        board current_board;
+        unpack_board(nodes->boards[current], current_board);
+        int current_g = nodes->g[current];
+        int current_h = nodes->h[current];
+        int current_move = nodes->moves[current];
+        if (trace != NULL) {
+            if (current_g + current_h > ctx->f_layer) {
+                ctx->f_layer = current_g + current_h;
+                trace_instant(trace, "f_layer", "f", ctx->f_layer);
+            }
+            // sample the sizes rather than emitting per expansion to keep overhead low
+            if ((stats->expanded & TRACE_SAMPLE_MASK) == 0) {
+                trace_counter(trace, "open_set", ENGINE_OPEN_SIZE(ctx));
+                trace_counter(trace, "closed_set", ENGINE_CLOSED_SIZE(ctx));
+            }
+        }
+        int current_hash = ENGINE_STATE_KEY(current_board);
+        if (ENGINE_CLOSED_INSERT(ctx, current_hash) != 0) {
+            status = OUT_OF_MEMORY;
+            break;
+        }
+        stats->expanded++;
+        stats->f_bound = current_g + current_h;
+        if (current_h < stats->best_h) {
+            stats->best_h = current_h;
+        }
+        if (report != NULL) {
+            record_expansion(report, current_board, current_g, current_h);
+        }
+
+        // check if we've reached the goal state
+        if (current_hash == ctx->goal_hash) {
+            // keep the solution in the context, the nodes are released when the search finishes
+            stats->steps = current_g;
+            trace_begin(trace, "reconstruct_path");
+            reconstruct_path(nodes, current, current_g, ctx->path);
+            trace_end(trace, "reconstruct_path");
+            status = SOLVED;
+            break;
+        }
+
+        // generate and hash every neighbor first and prefetch their closed set slots, so the cache misses overlap
+        board neighbor_boards[NEIGHBOR_CNT];
+        int neighbor_keys[NEIGHBOR_CNT];
+        int neighbor_valid[NEIGHBOR_CNT];
+        for (int i = 0; i < NEIGHBOR_CNT; i++) {
+            int row_offset = NEIGHBOR_OFFSETS[i][0];
+            int col_offset = NEIGHBOR_OFFSETS[i][1];
+            // undoing the incoming move gives the parent, which is always closed, so it isn't even generated
+            if (prune_inverse && NEIGHBOR_MOVES[i] == INVERSE_MOVES[current_move]) {
+                neighbor_valid[i] = 0;
+                continue;
+            }
+            // write a moved board state into the neighbor board, moves off the board are skipped
+            neighbor_valid[i] = move_board(current_board, neighbor_boards[i], row_offset, col_offset) == 0;
+            if (neighbor_valid[i]) {
+                neighbor_keys[i] = ENGINE_STATE_KEY(neighbor_boards[i]);
+                ENGINE_CLOSED_PREFETCH(ctx, neighbor_keys[i]);
+            }
+        }
+
+        // then probe the closed set and add the open neighbor states to the priority queue
+        for (int i = 0; i < NEIGHBOR_CNT; i++) {
+            if (neighbor_valid[i] && !ENGINE_CLOSED_HAS(ctx, neighbor_keys[i])) {
+                const tile* neighbor_board = neighbor_boards[i];
+
+                // create a new neighbor with the new board and calculated states, adding it to the store of all nodes
+                int neighbor_h = ENGINE_HEURISTIC(ctx, neighbor_board);
+                int neighbor = new_node(nodes, neighbor_board, current, current_g + 1, neighbor_h, NEIGHBOR_MOVES[i]);
+                if (neighbor < 0) {
+                    status = OUT_OF_MEMORY;
+                    break;
+                }
+                stats->generated++;
+
+                // add neighbor board to pq
+                if (ENGINE_OPEN_PUSH(ctx, neighbor, current_g + 1 + neighbor_h) != 0) {
+                    status = OUT_OF_MEMORY;
+                    break;
+                }
+            }
+        }
+    }
+
+    trace_end(trace, "search");
+    ctx->status = status;
+    if (status != IN_PROGRESS) {
+        finish_solve(ctx);
+    }
+    return status;
+}
+
+#undef ENGINE_STEP
+#undef ENGINE_STATE_KEY
+#undef ENGINE_HEURISTIC
+#undef ENGINE_OPEN_PUSH
+#undef ENGINE_OPEN_POP
+#undef ENGINE_OPEN_SIZE
+#undef ENGINE_CLOSED_INSERT
+#undef ENGINE_CLOSED_HAS
+#undef ENGINE_CLOSED_PREFETCH
+#undef ENGINE_CLOSED_SIZE
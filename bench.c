@@ -0,0 +1,581 @@
+//
+// Joseph Prichard 2023
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "bench.h"
+
+// BENCHMARK IMPLEMENTATION
+
+static volatile int bench_sink;
+
+uint32_t next_rand(uint32_t* state) {
+    // xorshift32, deterministic for a fixed seed so every run sees the same inputs
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+void random_board(board brd, uint32_t* state) {
+    // random walk from the goal so every generated board is solvable
+    board goal = {1, 2, 3, 4, 5, 6, 7, 8, 0};
+    memcpy(brd, goal, sizeof(board));
+    for (int i = 0; i < BENCH_WALK; i++) {
+        board next;
+        int n = (int) (next_rand(state) % NEIGHBOR_CNT);
+        if (move_board(brd, next, NEIGHBOR_OFFSETS[n][0], NEIGHBOR_OFFSETS[n][1]) == 0) {
+            memcpy(brd, next, sizeof(board));
+        }
+    }
+}
+
+void init_bench_data(bench_data* data) {
+    uint32_t state = BENCH_SEED;
+    board goal = {1, 2, 3, 4, 5, 6, 7, 8, 0};
+    index_goal(goal, data->goal_index);
+    index_lanes(data->goal_index, &data->lanes);
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        random_board(data->boards[i], &state);
+        data->hashes[i] = hash_board(data->boards[i]);
+        data->scores[i] = (int) (next_rand(&state) % 64);
+    }
+    data->large_ht = new_ht(NULL);
+    for (int i = 0; i < BENCH_LARGE_KEYS; i++) {
+        insert_into_ht(data->large_ht, (int) (next_rand(&state) % BENCH_KEY_RANGE));
+    }
+    for (int i = 0; i < BENCH_LARGE_LOOKUPS; i++) {
+        data->large_keys[i] = (int) (next_rand(&state) % BENCH_KEY_RANGE);
+    }
+}
+
+double bench_hash_board(bench_data* data, long* ops) {
+    int acc = 0;
+    double start = now_ns();
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        acc += hash_board(data->boards[i]);
+    }
+    double elapsed = now_ns() - start;
+    bench_sink = acc;
+    *ops = BENCH_INPUTS;
+    return elapsed;
+}
+
+double bench_move_board(bench_data* data, long* ops) {
+    int acc = 0;
+    double start = now_ns();
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        board out;
+        int n = i % NEIGHBOR_CNT;
+        acc += move_board(data->boards[i], out, NEIGHBOR_OFFSETS[n][0], NEIGHBOR_OFFSETS[n][1]) + out[0];
+    }
+    double elapsed = now_ns() - start;
+    bench_sink = acc;
+    *ops = BENCH_INPUTS;
+    return elapsed;
+}
+
+double bench_pack_board(bench_data* data, long* ops) {
+    // a round trip through the node store's board column
+    int acc = 0;
+    double start = now_ns();
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        board out;
+        unpack_board(pack_board(data->boards[i]), out);
+        acc += out[i % SIZE];
+    }
+    double elapsed = now_ns() - start;
+    bench_sink = acc;
+    *ops = BENCH_INPUTS;
+    return elapsed;
+}
+
+double bench_heuristic(bench_data* data, long* ops) {
+    int acc = 0;
+    double start = now_ns();
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        acc += heuristic(data->boards[i], data->goal_index);
+    }
+    double elapsed = now_ns() - start;
+    bench_sink = acc;
+    *ops = BENCH_INPUTS;
+    return elapsed;
+}
+
+double bench_kernel(bench_data* data, long* ops, heuristic_kernel kernel) {
+    int acc = 0;
+    double start = now_ns();
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        acc += kernel(data->boards[i], &data->lanes);
+    }
+    double elapsed = now_ns() - start;
+    bench_sink = acc;
+    *ops = BENCH_INPUTS;
+    return elapsed;
+}
+
+double bench_manhattan_scalar(bench_data* data, long* ops) {
+    return bench_kernel(data, ops, manhattan_scalar);
+}
+
+#ifdef HAVE_X86_KERNELS
+
+double bench_manhattan_sse42(bench_data* data, long* ops) {
+    return bench_kernel(data, ops, manhattan_sse42);
+}
+
+double bench_manhattan_avx2(bench_data* data, long* ops) {
+    return bench_kernel(data, ops, manhattan_avx2);
+}
+
+double bench_manhattan_avx512(bench_data* data, long* ops) {
+    return bench_kernel(data, ops, manhattan_avx512);
+}
+
+#endif
+
+double bench_misplaced_tiles(bench_data* data, long* ops) {
+    int acc = 0;
+    double start = now_ns();
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        acc += misplaced_tiles(data->boards[i], data->goal_index);
+    }
+    double elapsed = now_ns() - start;
+    bench_sink = acc;
+    *ops = BENCH_INPUTS;
+    return elapsed;
+}
+
+double bench_push_pq(bench_data* data, long* ops) {
+    priority_q* pq = new_pq(NULL);
+    double start = now_ns();
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        push_pq(pq, i, data->scores[i]);
+    }
+    double elapsed = now_ns() - start;
+    bench_sink = pq->size;
+    free_pq(pq);
+    *ops = BENCH_INPUTS;
+    return elapsed;
+}
+
+double bench_pop_pq(bench_data* data, long* ops) {
+    // fill outside of the timed region so only the sift downs are measured
+    priority_q* pq = new_pq(NULL);
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        push_pq(pq, i, data->scores[i]);
+    }
+    int acc = 0;
+    double start = now_ns();
+    while (pq->size > 0) {
+        acc += data->scores[pop_pq(pq)];
+    }
+    double elapsed = now_ns() - start;
+    bench_sink = acc;
+    free_pq(pq);
+    *ops = BENCH_INPUTS;
+    return elapsed;
+}
+
+double bench_insert_into_ht(bench_data* data, long* ops) {
+    hash_table* ht = new_ht(NULL);
+    double start = now_ns();
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        insert_into_ht(ht, data->hashes[i]);
+    }
+    double elapsed = now_ns() - start;
+    bench_sink = ht->size;
+    free_ht(ht);
+    *ops = BENCH_INPUTS;
+    return elapsed;
+}
+
+double bench_ht_has_key(bench_data* data, long* ops) {
+    // insert every other key so half of the lookups hit and half miss
+    hash_table* ht = new_ht(NULL);
+    for (int i = 0; i < BENCH_INPUTS; i += 2) {
+        insert_into_ht(ht, data->hashes[i]);
+    }
+    int acc = 0;
+    double start = now_ns();
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        acc += ht_has_key(ht, data->hashes[i]);
+    }
+    double elapsed = now_ns() - start;
+    bench_sink = acc;
+    free_ht(ht);
+    *ops = BENCH_INPUTS;
+    return elapsed;
+}
+
+double bench_ht_has_key_large(bench_data* data, long* ops) {
+    // probes one after another like a naive expansion, each miss waits for the one before it
+    int acc = 0;
+    double start = now_ns();
+    for (int i = 0; i < BENCH_LARGE_LOOKUPS; i++) {
+        acc += ht_has_key(data->large_ht, data->large_keys[i]);
+    }
+    double elapsed = now_ns() - start;
+    bench_sink = acc;
+    *ops = BENCH_LARGE_LOOKUPS;
+    return elapsed;
+}
+
+double bench_prefetch_ht_large(bench_data* data, long* ops) {
+    // the same probes in groups of one expansion's neighbors, prefetched first so their misses overlap
+    int acc = 0;
+    double start = now_ns();
+    for (int i = 0; i < BENCH_LARGE_LOOKUPS; i += NEIGHBOR_CNT) {
+        for (int j = 0; j < NEIGHBOR_CNT; j++) {
+            prefetch_ht(data->large_ht, data->large_keys[i + j]);
+        }
+        for (int j = 0; j < NEIGHBOR_CNT; j++) {
+            acc += ht_has_key(data->large_ht, data->large_keys[i + j]);
+        }
+    }
+    double elapsed = now_ns() - start;
+    bench_sink = acc;
+    *ops = BENCH_LARGE_LOOKUPS;
+    return elapsed;
+}
+
+double bench_clear_ht(bench_data* data, long* ops) {
+    // clear a filled table many times, one clear is too short to time and the cost shouldn't depend on its capacity
+    hash_table* ht = new_ht(NULL);
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        insert_into_ht(ht, data->hashes[i]);
+    }
+    double start = now_ns();
+    for (int i = 0; i < BENCH_CLEARS; i++) {
+        clear_ht(ht);
+    }
+    double elapsed = now_ns() - start;
+    bench_sink = (int) ht->generation;
+    free_ht(ht);
+    *ops = BENCH_CLEARS;
+    return elapsed;
+}
+
+// replacement kernels are benchmarked by adding them next to the primitive they replace
+static const bench_case BENCH_CASES[] = {
+    {"hash_board", bench_hash_board, ISA_SCALAR},
+    {"move_board", bench_move_board, ISA_SCALAR},
+    {"pack_board", bench_pack_board, ISA_SCALAR},
+    {"heuristic", bench_heuristic, ISA_SCALAR},
+    {"manhattan_scalar", bench_manhattan_scalar, ISA_SCALAR},
+#ifdef HAVE_X86_KERNELS
+    {"manhattan_sse42", bench_manhattan_sse42, ISA_SSE42},
+    {"manhattan_avx2", bench_manhattan_avx2, ISA_AVX2},
+    {"manhattan_avx512", bench_manhattan_avx512, ISA_AVX512},
+#endif
+    {"misplaced_tiles", bench_misplaced_tiles, ISA_SCALAR},
+    {"push_pq", bench_push_pq, ISA_SCALAR},
+    {"pop_pq", bench_pop_pq, ISA_SCALAR},
+    {"insert_into_ht", bench_insert_into_ht, ISA_SCALAR},
+    {"ht_has_key", bench_ht_has_key, ISA_SCALAR},
+    {"ht_has_key_large", bench_ht_has_key_large, ISA_SCALAR},
+    {"prefetch_ht_large", bench_prefetch_ht_large, ISA_SCALAR},
+    {"clear_ht", bench_clear_ht, ISA_SCALAR},
+};
+
+void run_bench(const bench_case* bc, bench_data* data) {
+    long ops;
+    for (int i = 0; i < BENCH_WARMUP; i++) {
+        bc->fn(data, &ops);
+    }
+    // accumulate ns/op of each repetition to report the mean and the spread
+    double sum = 0, sum_sq = 0, min = 0;
+    for (int i = 0; i < BENCH_REPS; i++) {
+        double ns_per_op = bc->fn(data, &ops) / (double) ops;
+        sum += ns_per_op;
+        sum_sq += ns_per_op * ns_per_op;
+        if (i == 0 || ns_per_op < min) {
+            min = ns_per_op;
+        }
+    }
+    double mean = sum / BENCH_REPS;
+    double variance = sum_sq / BENCH_REPS - mean * mean;
+    double stddev = variance > 0 ? sqrt(variance) : 0;
+    printf("%-24s %10.2f %10.2f %10.2f\n", bc->name, mean, stddev, min);
+}
+
+int run_benches(solve_isa max_isa) {
+    bench_data* data = malloc(sizeof(bench_data));
+    if (data == NULL) {
+        printf("Failed to allocate bench_data");
+        return 1;
+    }
+    init_bench_data(data);
+
+    printf("%d inputs, %d warm-up and %d timed repetitions\n\n", BENCH_INPUTS, BENCH_WARMUP, BENCH_REPS);
+    printf("%-24s %10s %10s %10s\n", "benchmark", "ns/op", "stddev", "min");
+    for (size_t i = 0; i < sizeof(BENCH_CASES) / sizeof(BENCH_CASES[0]); i++) {
+        if (BENCH_CASES[i].isa <= max_isa) {
+            run_bench(&BENCH_CASES[i], data);
+        }
+    }
+
+    free_ht(data->large_ht);
+    free(data);
+    return 0;
+}
+
+// ALLOCATION COUNTER IMPLEMENTATION
+
+// the client is linked with --wrap for each of these, so every call the library makes lands here first. the count is
+// per thread so workers don't see each other's allocations
+static _Thread_local long thread_allocations;
+
+long allocator_calls() {
+    return thread_allocations;
+}
+
+void* __wrap_malloc(size_t size) {
+    thread_allocations++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t cnt, size_t size) {
+    thread_allocations++;
+    return __real_calloc(cnt, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    thread_allocations++;
+    return __real_realloc(ptr, size);
+}
+
+void* __wrap_aligned_alloc(size_t alignment, size_t size) {
+    thread_allocations++;
+    return __real_aligned_alloc(alignment, size);
+}
+
+void* __wrap_mmap(void* addr, size_t len, int prot, int flags, int fd, off_t offset) {
+    thread_allocations++;
+    return __real_mmap(addr, len, prot, flags, fd, offset);
+}
+
+// VALIDATION IMPLEMENTATION
+
+int check_path(const board initial_brd, const board goal_brd, const move* moves, int steps) {
+    // replay the moves, every one must stay on the board and the last must reach the goal
+    board brd;
+    memcpy(brd, initial_brd, sizeof(board));
+    for (int i = 0; i < steps; i++) {
+        if (apply_move(brd, moves[i]) != 0) {
+            return 1;
+        }
+    }
+    return memcmp(brd, goal_brd, sizeof(board)) != 0;
+}
+
+void validate_board(validate_job* job, solver_ctx* ctx, int rank, int warm) {
+    board brd;
+    unrank_board(rank, brd);
+    move moves[LONGEST_SOL];
+    solve_stats stats;
+    long calls = allocator_calls();
+    solve_status status = solve(ctx, brd, job->goal, moves, &stats);
+    calls = allocator_calls() - calls;
+    if (warm) {
+        atomic_fetch_add(&job->warm_solved, 1);
+    } else {
+        atomic_fetch_add(&job->expanded, stats.expanded);
+        atomic_fetch_add(&job->solved, 1);
+    }
+    if (!warm && stats.node_loads >= 0) {
+        atomic_fetch_add(&job->node_loads, stats.node_loads);
+        atomic_fetch_add(&job->remote_loads, stats.remote_loads);
+    }
+
+    if (status != SOLVED || stats.steps != job->distances[rank] || check_path(brd, job->goal, moves, stats.steps)) {
+        if (atomic_fetch_add(&job->failures, 1) < VALIDATE_MAX_FAILURES) {
+            printf("Failed on board with rank %d: status %d, %d steps, expected %d\n",
+                   rank, status, stats.steps, job->distances[rank]);
+        }
+    } else if (manhattan_scalar(brd, &job->lanes) != heuristic(brd, job->goal_index)) {
+        if (atomic_fetch_add(&job->failures, 1) < VALIDATE_MAX_FAILURES) {
+            printf("Scalar kernel disagrees with the heuristic on board with rank %d\n", rank);
+        }
+    } else if (warm && calls != 0) {
+        // a warm context already has the capacity for this board, so it must not call the allocator at all, whether or
+        // not the call is tracked by its budget
+        if (atomic_fetch_add(&job->failures, 1) < VALIDATE_MAX_FAILURES) {
+            printf("Warm solve of board with rank %d made %ld allocator calls\n", rank, calls);
+        }
+    }
+    // every vector kernel the cpu supports must match the scalar reference
+    for (int isa = ISA_SSE42; isa_supported((solve_isa) isa); isa++) {
+        if (kernel_for((solve_isa) isa)(brd, &job->lanes) != manhattan_scalar(brd, &job->lanes)
+            && atomic_fetch_add(&job->failures, 1) < VALIDATE_MAX_FAILURES) {
+            printf("%s kernel disagrees with scalar on board with rank %d\n", isa_name((solve_isa) isa), rank);
+        }
+    }
+}
+
+void* validate_worker(void* arg) {
+    validate_job* job = arg;
+    int worker = atomic_fetch_add(&job->next_worker, 1);
+    int node;
+    // placed before the context is created, so the memory it touches first is on the worker's node
+    if (place_worker(job->workers, worker, &node) != 0) {
+        printf("Failed to place worker %d\n", worker);
+        atomic_fetch_add(&job->failures, 1);
+        return NULL;
+    }
+    // every worker reuses its own context for all of its boards
+    solver_ctx* ctx = new_solver(0);
+    if (ctx == NULL || (job->workers->numa && set_solver_numa_node(ctx, node) != 0)) {
+        if (ctx != NULL) {
+            free_solver(ctx);
+        }
+        atomic_fetch_add(&job->failures, 1);
+        return NULL;
+    }
+    if (job->workers->counters && set_solver_counters(ctx, 1) != 0) {
+        atomic_store(&job->counters_missing, 1);
+    }
+    set_solver_algorithm(ctx, job->algorithm);
+    set_solver_pruning(ctx, job->pruning);
+    // only the table lookup walks the table, so the other algorithms are still checked against it
+    set_solver_table(ctx, job->algorithm == TABLE_LOOKUP ? job->distances : NULL);
+    set_solver_trace(ctx, trace_thread(job->trace, worker));
+    int first_chunk = -1;
+    for (;;) {
+        // claim ranks in chunks so workers rarely contend on the counter
+        int first = atomic_fetch_add(&job->next_rank, VALIDATE_CHUNK);
+        if (first >= PERM_CNT) {
+            break;
+        }
+        if (first_chunk < 0) {
+            first_chunk = first;
+        }
+        for (int rank = first; rank < first + VALIDATE_CHUNK && rank < PERM_CNT; rank++) {
+            if (job->distances[rank] != UNREACHABLE) {
+                validate_board(job, ctx, rank, 0);
+            }
+        }
+    }
+    // the rates only cover the exhaustive pass, so it ends when the last worker is done with it
+    long end = (long) now_ns();
+    long latest = atomic_load(&job->search_end_ns);
+    while (end > latest && !atomic_compare_exchange_weak(&job->search_end_ns, &latest, end)) {
+    }
+    // the context has now grown for every board it solved, so solving the first chunk again is allocation free
+    for (int rank = first_chunk; first_chunk >= 0 && rank < first_chunk + VALIDATE_CHUNK && rank < PERM_CNT; rank++) {
+        if (job->distances[rank] != UNREACHABLE) {
+            validate_board(job, ctx, rank, 1);
+        }
+    }
+    free_solver(ctx);
+    return NULL;
+}
+
+int place_worker(const worker_opts* opts, int worker, int* node) {
+    // a worker gets a cpu of its own from the list, otherwise with numa a whole node
+    *node = worker % numa_node_cnt();
+    if (opts->cpu_cnt > 0) {
+        if (pin_to_cpus(&opts->cpus[worker % opts->cpu_cnt], 1) != 0) {
+            return 1;
+        }
+        *node = current_numa_node();
+    } else if (opts->numa && pin_to_numa_node(*node) != 0) {
+        return 1;
+    }
+    return opts->policy != POLICY_OTHER && set_thread_policy(opts->policy, opts->priority) != 0;
+}
+
+int place_io_thread(const worker_opts* opts) {
+    // threads inherit the affinity of their creator, so this runs after the workers are started
+    if (opts->io_cpu_cnt > 0) {
+        return pin_to_cpus(opts->io_cpus, opts->io_cpu_cnt);
+    }
+    return opts->cpu_cnt > 0 && pin_away_from_cpus(opts->cpus, opts->cpu_cnt) != 0;
+}
+
+int run_validation(const board goal_brd, const uint8_t* distances, solve_algorithm algorithm, solve_pruning pruning,
+                   const worker_opts* workers, trace_writer* trace) {
+    int thread_cnt = workers->thread_cnt;
+    int numa = workers->numa;
+    int counters = workers->counters;
+    validate_job job;
+    job.distances = distances;
+    job.algorithm = algorithm;
+    job.pruning = pruning;
+    job.workers = workers;
+    job.trace = trace;
+    job.goal = goal_brd;
+    index_goal(goal_brd, job.goal_index);
+    index_lanes(job.goal_index, &job.lanes);
+    atomic_init(&job.next_rank, 0);
+    atomic_init(&job.next_worker, 0);
+    atomic_init(&job.solved, 0);
+    atomic_init(&job.warm_solved, 0);
+    atomic_init(&job.search_end_ns, 0);
+    atomic_init(&job.failures, 0);
+    atomic_init(&job.expanded, 0);
+    atomic_init(&job.node_loads, 0);
+    atomic_init(&job.remote_loads, 0);
+    atomic_init(&job.counters_missing, 0);
+
+    printf("Validating every reachable board on %d threads...\n", thread_cnt);
+    if (workers->cpu_cnt > 0) {
+        printf("Workers pinned round robin to %d cpus\n", workers->cpu_cnt);
+    } else if (numa) {
+        printf("Workers pinned round robin to %d NUMA nodes\n", numa_node_cnt());
+    }
+    double start = now_ns();
+
+    pthread_t* threads = malloc(sizeof(pthread_t) * thread_cnt);
+    if (threads == NULL) {
+        printf("Failed to allocate threads");
+        return 1;
+    }
+    // the workers already started still validate every board between them, so a failed start only counts as a failure
+    int started = 0;
+    for (; started < thread_cnt; started++) {
+        if (pthread_create(&threads[started], NULL, validate_worker, &job) != 0) {
+            printf("Failed to start worker %d\n", started);
+            atomic_fetch_add(&job.failures, 1);
+            break;
+        }
+    }
+    // the main thread only prints, but it shouldn't take a worker's cpu while it does
+    if (place_io_thread(workers) != 0) {
+        printf("Failed to keep the main thread off the worker cpus\n");
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    double seconds = ((double) atomic_load(&job.search_end_ns) - start) / 1e9;
+    long solved = atomic_load(&job.solved);
+    long expanded = atomic_load(&job.expanded);
+    printf("Solved %ld boards in %.3f s: %.0f solves/s, %.0f expansions/s\n",
+           solved, seconds, (double) solved / seconds, (double) expanded / seconds);
+    printf("Solved %ld boards again on warm contexts\n", atomic_load(&job.warm_solved));
+    // exactly half of the permutations are reachable, a different count means boards were skipped or repeated
+    if (solved != PERM_CNT / 2) {
+        printf("Expected %d boards, the exhaustive pass solved %ld\n", PERM_CNT / 2, solved);
+        atomic_fetch_add(&job.failures, 1);
+    }
+    long failures = atomic_load(&job.failures);
+    if (counters && atomic_load(&job.counters_missing)) {
+        printf("Hardware counters are unavailable\n");
+    } else if (counters) {
+        long node_loads = atomic_load(&job.node_loads);
+        long remote_loads = atomic_load(&job.remote_loads);
+        printf("Loads served from memory: %ld, %ld from a remote node (%.2f%%)\n", node_loads, remote_loads,
+               node_loads > 0 ? 100.0 * (double) remote_loads / (double) node_loads : 0.0);
+    }
+    printf("%ld failures\n", failures);
+    return failures > 0;
+}
@@ -0,0 +1,126 @@
+//
+// Joseph Prichard 2023
+//
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <stdatomic.h>
+#include "solver_internal.h"
+
+#define BENCH_INPUTS 4096
+#define BENCH_WARMUP 3
+#define BENCH_REPS 25
+#define BENCH_SEED 0x9E3779B9u
+#define BENCH_WALK 60
+#define BENCH_LARGE_KEYS (1 << 22)
+#define BENCH_LARGE_LOOKUPS (1 << 20)
+#define BENCH_KEY_RANGE 876543211 // one past the largest board hash, keys in range keep h + i of a probe from overflowing
+#define BENCH_CLEARS 100000
+#define VALIDATE_CHUNK 256
+#define VALIDATE_MAX_FAILURES 10
+#define MAX_CPUS 1024
+
+// TYPE AND FUNCTION DEFINITIONS
+
+// where and how the worker threads run, filled in from the command line
+typedef struct worker_opts {
+    int thread_cnt;
+    int numa; // without a cpu list, workers are pinned round robin to the nodes
+    int counters;
+    int cpus[MAX_CPUS]; // each worker is pinned to one of these round robin, none leaves them unpinned
+    int cpu_cnt;
+    int io_cpus[MAX_CPUS]; // cpus of the threads doing I/O, none keeps them off the worker cpus
+    int io_cpu_cnt;
+    thread_policy policy;
+    int priority;
+} worker_opts;
+
+typedef struct validate_job {
+    const uint8_t* distances;
+    const tile* goal;
+    solve_algorithm algorithm;
+    solve_pruning pruning;
+    const worker_opts* workers;
+    trace_writer* trace;
+    int goal_index[SIZE];
+    goal_lanes lanes;
+    atomic_int next_rank;
+    atomic_int next_worker;
+    atomic_long solved; // boards of the exhaustive pass, the warm re-solves are counted apart
+    atomic_long warm_solved;
+    atomic_long search_end_ns; // when the last worker finished the exhaustive pass
+    atomic_long failures;
+    atomic_long expanded;
+    atomic_long node_loads;
+    atomic_long remote_loads;
+    atomic_int counters_missing;
+} validate_job;
+
+typedef struct bench_data {
+    board boards[BENCH_INPUTS];
+    int hashes[BENCH_INPUTS];
+    int scores[BENCH_INPUTS]; // random f values for the heap benchmarks
+    hash_table* large_ht; // larger than the private caches, and the lookups touch too many lines to stay cached
+    int large_keys[BENCH_LARGE_LOOKUPS];
+    int goal_index[SIZE];
+    goal_lanes lanes;
+} bench_data;
+
+// runs one timed pass over the inputs, returns elapsed nanoseconds and writes the op count
+typedef double (*bench_fn)(bench_data*, long* ops);
+
+typedef struct bench_case {
+    const char* name;
+    bench_fn fn;
+    solve_isa isa; // skipped unless the cpu supports it
+} bench_case;
+
+uint32_t next_rand(uint32_t* state);
+
+void random_board(board brd, uint32_t* state);
+
+void init_bench_data(bench_data*);
+
+void run_bench(const bench_case*, bench_data*);
+
+int run_benches(solve_isa max_isa);
+
+long allocator_calls();
+
+void* __real_malloc(size_t size);
+
+void* __real_calloc(size_t cnt, size_t size);
+
+void* __real_realloc(void* ptr, size_t size);
+
+void* __real_aligned_alloc(size_t alignment, size_t size);
+
+void* __real_mmap(void* addr, size_t len, int prot, int flags, int fd, off_t offset);
+
+void* __wrap_malloc(size_t size);
+
+void* __wrap_calloc(size_t cnt, size_t size);
+
+void* __wrap_realloc(void* ptr, size_t size);
+
+void* __wrap_aligned_alloc(size_t alignment, size_t size);
+
+void* __wrap_mmap(void* addr, size_t len, int prot, int flags, int fd, off_t offset);
+
+int check_path(const board initial_brd, const board goal_brd, const move* moves, int steps);
+
+void validate_board(validate_job*, solver_ctx*, int rank, int warm);
+
+void* validate_worker(void*);
+
+int place_worker(const worker_opts*, int worker, int* node);
+
+int place_io_thread(const worker_opts*);
+
+int run_validation(const board goal_brd, const uint8_t* distances, solve_algorithm, solve_pruning, const worker_opts*,
+                   trace_writer*);
+
+#endif
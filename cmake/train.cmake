@@ -0,0 +1,17 @@
+# runs the instrumented build over the benchmark corpus, invoked by the pgo target with PUZZLE and SOURCE_DIR set
+
+file(GLOB corpus "${SOURCE_DIR}/bench/*.txt")
+list(APPEND corpus "${SOURCE_DIR}/sample_input.txt")
+
+execute_process(COMMAND ${PUZZLE} --bench OUTPUT_QUIET RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "training run ${PUZZLE} --bench failed: ${result}")
+endif ()
+
+foreach (board ${corpus})
+    # unsolvable boards are part of the corpus, so only a crash fails the training
+    execute_process(COMMAND ${PUZZLE} --stats ${board} OUTPUT_QUIET RESULT_VARIABLE result)
+    if (NOT result MATCHES "^[0-9]+$")
+        message(FATAL_ERROR "training run on ${board} failed: ${result}")
+    endif ()
+endforeach ()
@@ -0,0 +1,280 @@
+//
+// Joseph Prichard 2023
+//
+
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include "solver_internal.h"
+
+// DUPLICATE PRUNING IMPLEMENTATION
+
+fsm* new_fsm(mem_budget* budget) {
+    fsm* pruner = malloc(sizeof(fsm));
+    if (pruner == NULL) {
+        return NULL;
+    }
+    pruner->next = NULL;
+    pruner->node_cnt = 0;
+    pruner->node_cap = 0;
+    pruner->mem = (mem_usage) {0};
+    if (build_fsm(pruner, budget) != 0) {
+        free_fsm(pruner, budget);
+        return NULL;
+    }
+    return pruner;
+}
+
+int grow_fsm(fsm* pruner, mem_budget* budget) {
+    int new_cap = pruner->node_cap > 0 ? pruner->node_cap * 2 : 1024;
+    size_t old_size = sizeof(*pruner->next) * pruner->node_cap;
+    void* next = realloc_tracked(pruner->next, old_size, sizeof(*pruner->next) * new_cap, &pruner->mem, budget);
+    if (next == NULL) {
+        return 1;
+    }
+    pruner->next = next;
+    pruner->node_cap = new_cap;
+    return 0;
+}
+
+int add_fsm_node(fsm* pruner, mem_budget* budget, board** boards, int** depths, const board brd, int depth) {
+    // the scratch arrays of boards and depths grow alongside the transitions
+    if (pruner->node_cnt >= pruner->node_cap) {
+        if (grow_fsm(pruner, budget) != 0) {
+            return -1;
+        }
+        board* new_boards = realloc(*boards, sizeof(board) * pruner->node_cap);
+        if (new_boards == NULL) {
+            return -1;
+        }
+        *boards = new_boards;
+        int* new_depths = realloc(*depths, sizeof(int) * pruner->node_cap);
+        if (new_depths == NULL) {
+            return -1;
+        }
+        *depths = new_depths;
+    }
+    int node = pruner->node_cnt++;
+    memcpy((*boards)[node], brd, sizeof(board));
+    (*depths)[node] = depth;
+    for (int i = 0; i < NEIGHBOR_CNT; i++) {
+        pruner->next[node][i] = FSM_ILLEGAL;
+    }
+    return node;
+}
+
+int build_fsm(fsm* pruner, mem_budget* budget) {
+    // a breadth first search over move strings from each blank position visits them shortest first, then in move
+    // order. a string reaching a board that an earlier string already reached is a duplicate, and the first shortest
+    // path in that order never contains one, so IDA* can reject any path that ends in a duplicate
+    board* boards = NULL;
+    int* depths = NULL;
+    int* fail = NULL;
+    int* queue = NULL;
+    hash_table* seen = NULL;
+    int err = 1;
+
+    for (int p = 0; p < SIZE; p++) {
+        // distinct tiles so two strings only reach the same board if they move every tile the same way
+        board root_brd;
+        for (int i = 0; i < SIZE; i++) {
+            root_brd[i] = (tile) (i + 1);
+        }
+        root_brd[p] = 0;
+        if ((seen = new_ht(NULL)) == NULL || insert_into_ht(seen, hash_board(root_brd)) != 0) {
+            goto done;
+        }
+        int root = add_fsm_node(pruner, budget, &boards, &depths, root_brd, 0);
+        if (root < 0) {
+            goto done;
+        }
+        pruner->roots[p] = root;
+        for (int u = root; u < pruner->node_cnt; u++) {
+            if (depths[u] >= FSM_DEPTH) {
+                continue;
+            }
+            for (int m = 0; m < NEIGHBOR_CNT; m++) {
+                board next_brd;
+                if (move_board(boards[u], next_brd, NEIGHBOR_OFFSETS[m][0], NEIGHBOR_OFFSETS[m][1]) != 0) {
+                    continue;
+                }
+                int key = hash_board(next_brd);
+                if (ht_has_key(seen, key)) {
+                    pruner->next[u][m] = FSM_PRUNE;
+                    continue;
+                }
+                int v;
+                if (insert_into_ht(seen, key) != 0
+                    || (v = add_fsm_node(pruner, budget, &boards, &depths, next_brd, depths[u] + 1)) < 0) {
+                    goto done;
+                }
+                pruner->next[u][m] = v;
+            }
+        }
+        free_ht(seen);
+        seen = NULL;
+    }
+
+    // link each node to the node of its longest proper suffix, which ends with the blank at the same position, and
+    // fill the missing transitions from it. nodes are visited by depth so every suffix is complete before it is used
+    fail = malloc(sizeof(int) * pruner->node_cnt);
+    queue = malloc(sizeof(int) * pruner->node_cnt);
+    if (fail == NULL || queue == NULL) {
+        goto done;
+    }
+    int tail = 0;
+    for (int p = 0; p < SIZE; p++) {
+        fail[pruner->roots[p]] = pruner->roots[p];
+        queue[tail++] = pruner->roots[p];
+    }
+    for (int head = 0; head < tail; head++) {
+        int u = queue[head];
+        for (int m = 0; m < NEIGHBOR_CNT; m++) {
+            int v = pruner->next[u][m];
+            if (v >= 0) {
+                fail[v] = depths[u] == 0 ? pruner->roots[find_zero(boards[v])] : pruner->next[fail[u]][m];
+                queue[tail++] = v;
+            } else if (v == FSM_ILLEGAL && depths[u] > 0) {
+                pruner->next[u][m] = pruner->next[fail[u]][m];
+            }
+        }
+    }
+    err = 0;
+
+done:
+    if (seen != NULL) {
+        free_ht(seen);
+    }
+    free(boards);
+    free(depths);
+    free(fail);
+    free(queue);
+    return err;
+}
+
+void free_fsm(fsm* pruner, mem_budget* budget) {
+    free_tracked(pruner->next, sizeof(*pruner->next) * pruner->node_cap, &pruner->mem, budget);
+    free(pruner);
+}
+
+// IDA* IMPLEMENTATION
+
+solve_status start_ida(solver_ctx* ctx) {
+    // a depth first search never runs out of states, so unsolvable boards are rejected up front
+    if (!is_solvable(ctx->initial, ctx->goal)) {
+        return UNSOLVABLE;
+    }
+    if (ctx->pruning == PRUNE_FSM && ctx->pruner == NULL && (ctx->pruner = new_fsm(&ctx->budget)) == NULL) {
+        return OUT_OF_MEMORY;
+    }
+    ida_search* ida = &ctx->ida;
+    ida_frame* root = &ida->stack[0];
+    memcpy(root->board, ctx->initial, sizeof(board));
+    root->move = NONE;
+    root->g = 0;
+    root->h = estimate(ctx, ctx->initial);
+    root->next = 0;
+    root->state = ctx->pruner != NULL ? ctx->pruner->roots[find_zero(ctx->initial)] : 0;
+    ida->depth = 0;
+    ida->bound = root->h;
+    ida->next_bound = INT_MAX;
+    ctx->stats.best_h = root->h;
+    return IN_PROGRESS;
+}
+
+solve_status step_ida(solver_ctx* ctx, long max_expansions) {
+    ida_search* ida = &ctx->ida;
+    trace_buffer* trace = ctx->trace;
+    solve_report* report = ctx->report;
+    solve_stats* stats = &ctx->stats;
+    const fsm* pruner = ctx->pruning == PRUNE_FSM ? ctx->pruner : NULL;
+    int prune_inverse = ctx->pruning != PRUNE_NONE;
+    solve_status status = ctx->status;
+    if (status != IN_PROGRESS) {
+        return status;
+    }
+    trace_begin(trace, "search");
+
+    // walk the path on the explicit stack until the goal is found or this slice is used up
+    for (long n = 0; status == IN_PROGRESS && n < max_expansions;) {
+        if (ida->depth < 0) {
+            // the iteration is exhausted, search again with the smallest f that exceeded the bound
+            ida->bound = ida->next_bound;
+            ida->next_bound = INT_MAX;
+            ida->depth = 0;
+            ida->stack[0].next = 0;
+            trace_instant(trace, "f_layer", "f", ida->bound);
+            if ((ctx->algorithm == AUTO_SELECT || ctx->algorithm == TABLE_LOOKUP) && prefer_astar(ctx, ida->bound)) {
+                // the next iteration alone is predicted to cost more than all of A*, so the search moves over
+                ctx->active = ASTAR;
+                ctx->switch_expanded = stats->expanded;
+                status = start_astar(ctx);
+                break;
+            }
+            continue;
+        }
+        ida_frame* top = &ida->stack[ida->depth];
+        if (top->next == 0) {
+            // first visit of a node is its expansion
+            if ((stats->expanded & CANCEL_CHECK_MASK) == 0 && (status = poll_cancel(ctx, ctx->deadline)) != IN_PROGRESS) {
+                break;
+            }
+            stats->expanded++;
+            n++;
+            stats->f_bound = ida->bound;
+            if (top->h < stats->best_h) {
+                stats->best_h = top->h;
+            }
+            if (report != NULL) {
+                record_expansion(report, top->board, top->g, top->h);
+            }
+            // both heuristics are zero only on the goal
+            if (top->h == 0) {
+                stats->steps = ida->depth;
+                for (int i = 1; i <= ida->depth; i++) {
+                    ctx->path[i - 1] = ida->stack[i].move;
+                }
+                status = SOLVED;
+                break;
+            }
+        }
+        if (top->next >= NEIGHBOR_CNT) {
+            ida->depth--;
+            continue;
+        }
+        int i = top->next++;
+        if (prune_inverse && NEIGHBOR_MOVES[i] == INVERSE_MOVES[top->move]) {
+            continue;
+        }
+        int state = 0;
+        if (pruner != NULL && (state = pruner->next[top->state][i]) == FSM_PRUNE) {
+            continue;
+        }
+        ida_frame* child = &ida->stack[ida->depth + 1];
+        if (ida->depth >= LONGEST_SOL
+            || move_board(top->board, child->board, NEIGHBOR_OFFSETS[i][0], NEIGHBOR_OFFSETS[i][1]) != 0) {
+            continue;
+        }
+        child->h = estimate(ctx, child->board);
+        stats->generated++;
+        int f = top->g + 1 + child->h;
+        if (f > ida->bound) {
+            if (f < ida->next_bound) {
+                ida->next_bound = f;
+            }
+            continue;
+        }
+        child->move = (move) NEIGHBOR_MOVES[i];
+        child->g = top->g + 1;
+        child->next = 0;
+        child->state = state;
+        ida->depth++;
+    }
+
+    trace_end(trace, "search");
+    ctx->status = status;
+    if (status != IN_PROGRESS) {
+        finish_solve(ctx);
+    }
+    return status;
+}
@@ -0,0 +1,147 @@
+//
+// Joseph Prichard 2023
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "solver_internal.h"
+
+#ifdef HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+// GLOBALS
+
+static const char* ISA_STRINGS[ISA_CNT] = {"scalar", "sse4.2", "avx2", "avx512"};
+
+// row and column of each position, padded to a full vector
+static const _Alignas(16) uint8_t POS_ROWS[16] = {0, 0, 0, 1, 1, 1, 2, 2, 2};
+static const _Alignas(16) uint8_t POS_COLS[16] = {0, 1, 2, 0, 1, 2, 0, 1, 2};
+// both in one vector, rows in the low half and columns in the high half as in goal_lanes
+static const _Alignas(32) uint8_t POS_LANES[32] = {
+    0, 0, 0, 1, 1, 1, 2, 2, 2, 0, 0, 0, 0, 0, 0, 0,
+    0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 0, 0, 0, 0, 0, 0
+};
+
+// DISPATCH IMPLEMENTATION
+
+solve_isa detect_isa() {
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl")) {
+        return ISA_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return ISA_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return ISA_SSE42;
+    }
+#endif
+    return ISA_SCALAR;
+}
+
+int isa_supported(solve_isa isa) {
+    // every level implies the ones below it
+    return isa >= ISA_SCALAR && isa <= detect_isa();
+}
+
+const char* isa_name(solve_isa isa) {
+    return isa >= ISA_SCALAR && isa < ISA_CNT ? ISA_STRINGS[isa] : "unknown";
+}
+
+int parse_isa(const char* name, solve_isa* isa) {
+    for (int i = 0; i < ISA_CNT; i++) {
+        if (strcmp(name, ISA_STRINGS[i]) == 0) {
+            *isa = (solve_isa) i;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+heuristic_kernel kernel_for(solve_isa isa) {
+    switch (isa) {
+#ifdef HAVE_X86_KERNELS
+        case ISA_AVX512:
+            return manhattan_avx512;
+        case ISA_AVX2:
+            return manhattan_avx2;
+        case ISA_SSE42:
+            return manhattan_sse42;
+#endif
+        default:
+            return manhattan_scalar;
+    }
+}
+
+// KERNEL IMPLEMENTATION
+
+void index_lanes(const int* goal_index, goal_lanes* lanes) {
+    memset(lanes, 0, sizeof(goal_lanes));
+    for (int i = 0; i < SIZE; i++) {
+        lanes->rows[i] = (uint8_t) (goal_index[i] / ROWS);
+        lanes->cols[i] = (uint8_t) (goal_index[i] % ROWS);
+    }
+}
+
+int manhattan_scalar(const board brd, const goal_lanes* lanes) {
+    // reference for the vector kernels, the same sum over the lane tables
+    int h = 0;
+    for (int i = 0; i < SIZE; i++) {
+        int t = brd[i];
+        if (t != 0) {
+            h += abs(lanes->rows[t] - POS_ROWS[i]) + abs(lanes->cols[t] - POS_COLS[i]);
+        }
+    }
+    return h;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+__attribute__((target("sse4.2")))
+int manhattan_sse42(const board brd, const goal_lanes* lanes) {
+    // looks up the goal row and column of every tile with a shuffle, the padding lanes hold the blank and are masked
+    __m128i low = _mm_loadl_epi64((const __m128i*) brd);
+    __m128i tiles = _mm_insert_epi8(low, brd[SIZE - 1], SIZE - 1);
+    __m128i rows = _mm_shuffle_epi8(_mm_load_si128((const __m128i*) lanes->rows), tiles);
+    __m128i cols = _mm_shuffle_epi8(_mm_load_si128((const __m128i*) lanes->cols), tiles);
+    __m128i dist = _mm_add_epi8(
+        _mm_abs_epi8(_mm_sub_epi8(rows, _mm_load_si128((const __m128i*) POS_ROWS))),
+        _mm_abs_epi8(_mm_sub_epi8(cols, _mm_load_si128((const __m128i*) POS_COLS))));
+    dist = _mm_andnot_si128(_mm_cmpeq_epi8(tiles, _mm_setzero_si128()), dist);
+    __m128i sums = _mm_sad_epu8(dist, _mm_setzero_si128());
+    return _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
+}
+
+__attribute__((target("avx2")))
+int manhattan_avx2(const board brd, const goal_lanes* lanes) {
+    // the board goes in both halves of one 256-bit vector, and since the shuffle stays within each half, the low half
+    // looks up the rows and the high half the columns, so the distances take one shuffle, subtract and abs
+    __m128i low = _mm_loadl_epi64((const __m128i*) brd);
+    __m128i tiles = _mm_insert_epi8(low, brd[SIZE - 1], SIZE - 1);
+    __m256i both = _mm256_broadcastsi128_si256(tiles);
+    __m256i goal = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*) lanes->rows), both);
+    __m256i dist = _mm256_abs_epi8(_mm256_sub_epi8(goal, _mm256_load_si256((const __m256i*) POS_LANES)));
+    dist = _mm256_andnot_si256(_mm256_cmpeq_epi8(both, _mm256_setzero_si256()), dist);
+    // one partial sum per 64-bit lane, folded into two and then one
+    __m256i sums = _mm256_sad_epu8(dist, _mm256_setzero_si256());
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+    return _mm_cvtsi128_si32(half) + _mm_extract_epi16(half, 4);
+}
+
+__attribute__((target("avx512bw,avx512vl")))
+int manhattan_avx512(const board brd, const goal_lanes* lanes) {
+    // a masked load reads exactly the board and zeroes the padding lanes, the blank is masked out of the sum
+    __m128i tiles = _mm_maskz_loadu_epi8(0x1FF, brd);
+    __mmask16 occupied = _mm_test_epi8_mask(tiles, tiles);
+    __m128i rows = _mm_shuffle_epi8(_mm_load_si128((const __m128i*) lanes->rows), tiles);
+    __m128i cols = _mm_shuffle_epi8(_mm_load_si128((const __m128i*) lanes->cols), tiles);
+    __m128i dist = _mm_maskz_add_epi8(occupied,
+        _mm_abs_epi8(_mm_sub_epi8(rows, _mm_load_si128((const __m128i*) POS_ROWS))),
+        _mm_abs_epi8(_mm_sub_epi8(cols, _mm_load_si128((const __m128i*) POS_COLS))));
+    __m128i sums = _mm_sad_epu8(dist, _mm_setzero_si128());
+    return _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
+}
+
+#endif
@@ -0,0 +1,225 @@
+//
+// Joseph Prichard 2023
+//
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#include "solver_internal.h"
+
+// GLOBALS
+
+// from the kernel's mempolicy.h, declared here so libnuma isn't needed for its headers either
+#define MPOL_PREFERRED 1
+
+static const char* POLICY_STRINGS[POLICY_CNT] = {"other", "batch", "idle", "fifo", "rr"};
+static const int POLICY_VALUES[POLICY_CNT] = {SCHED_OTHER, SCHED_BATCH, SCHED_IDLE, SCHED_FIFO, SCHED_RR};
+
+// TOPOLOGY IMPLEMENTATION
+
+int numa_node_cnt() {
+    // nodes are numbered densely from 0, a kernel without NUMA support has one
+    int cnt = 0;
+    char path[64];
+    for (;;) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", cnt);
+        if (access(path, F_OK) != 0) {
+            break;
+        }
+        cnt++;
+    }
+    return cnt > 0 ? cnt : 1;
+}
+
+int current_numa_node() {
+    unsigned int cpu;
+    unsigned int node;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) {
+        return 0;
+    }
+    return (int) node;
+}
+
+int parse_cpu_list(const char* list, cpu_set_t* cpus) {
+    // the kernel's list format, comma separated cpus and inclusive ranges like "0-3,8,10-11"
+    CPU_ZERO(cpus);
+    const char* p = list;
+    while (*p != '\0' && *p != '\n') {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) {
+            return 1;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first) {
+                return 1;
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, cpus);
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0' && *p != '\n') {
+            return 1;
+        }
+    }
+    return CPU_COUNT(cpus) == 0;
+}
+
+int pin_to_numa_node(int node) {
+    char path[64];
+    char list[1024];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        // without NUMA support every cpu is on node 0, so there is nothing to pin to
+        return node != 0;
+    }
+    int err = fgets(list, sizeof(list), file) == NULL;
+    fclose(file);
+    cpu_set_t cpus;
+    if (err || parse_cpu_list(list, &cpus) != 0) {
+        return 1;
+    }
+    return sched_setaffinity(0, sizeof(cpu_set_t), &cpus) != 0;
+}
+
+// AFFINITY IMPLEMENTATION
+
+int parse_cpus(const char* list, int* out_cpus, int capacity) {
+    cpu_set_t cpus;
+    if (parse_cpu_list(list, &cpus) != 0) {
+        return -1;
+    }
+    int cnt = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && cnt < capacity; cpu++) {
+        if (CPU_ISSET(cpu, &cpus)) {
+            out_cpus[cnt++] = cpu;
+        }
+    }
+    return cnt;
+}
+
+int pin_to_cpus(const int* cpus, int cnt) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = 0; i < cnt; i++) {
+        if (cpus[i] < 0 || cpus[i] >= CPU_SETSIZE) {
+            return 1;
+        }
+        CPU_SET(cpus[i], &set);
+    }
+    return cnt == 0 || sched_setaffinity(0, sizeof(cpu_set_t), &set) != 0;
+}
+
+int pin_away_from_cpus(const int* cpus, int cnt) {
+    // every cpu the thread may run on now, less the ones reserved for others
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &set) != 0) {
+        return 1;
+    }
+    for (int i = 0; i < cnt; i++) {
+        if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE) {
+            CPU_CLR(cpus[i], &set);
+        }
+    }
+    return CPU_COUNT(&set) == 0 || sched_setaffinity(0, sizeof(cpu_set_t), &set) != 0;
+}
+
+int set_thread_policy(thread_policy policy, int priority) {
+    // linux schedules threads individually, so this only changes the calling thread. the real time policies need
+    // a priority from 1 to 99 and CAP_SYS_NICE, the others take 0
+    if (policy < POLICY_OTHER || policy >= POLICY_CNT) {
+        return 1;
+    }
+    struct sched_param param = {0};
+    param.sched_priority = policy == POLICY_FIFO || policy == POLICY_RR ? priority : 0;
+    return sched_setscheduler(0, POLICY_VALUES[policy], &param) != 0;
+}
+
+int parse_thread_policy(const char* name, thread_policy* policy) {
+    for (int i = 0; i < POLICY_CNT; i++) {
+        if (strcmp(name, POLICY_STRINGS[i]) == 0) {
+            *policy = (thread_policy) i;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// PLACEMENT IMPLEMENTATION
+
+int bind_pages(void* ptr, size_t size, int node) {
+    // prefer the node rather than bind to it, so a full node spills over instead of failing the fault
+    unsigned long mask[NUMA_MASK_WORDS] = {0};
+    if (node < 0 || node >= NUMA_MASK_WORDS * 64) {
+        return 1;
+    }
+    mask[node / 64] = 1UL << (node % 64);
+    return syscall(SYS_mbind, ptr, size, MPOL_PREFERRED, mask, (unsigned long) NUMA_MASK_WORDS * 64, 0) != 0;
+}
+
+// COUNTERS IMPLEMENTATION
+
+int open_counter(int result) {
+    // counts the calling thread on any cpu, only in user space so the solver's own loads are measured
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_NODE | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+int open_counters(int* fds) {
+    fds[0] = open_counter(PERF_COUNT_HW_CACHE_RESULT_ACCESS);
+    fds[1] = open_counter(PERF_COUNT_HW_CACHE_RESULT_MISS);
+    if (fds[0] < 0 || fds[1] < 0) {
+        close_counters(fds);
+        return 1;
+    }
+    return 0;
+}
+
+void start_counters(const int* fds) {
+    for (int i = 0; i < COUNTER_CNT && fds[i] >= 0; i++) {
+        ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void read_counters(const int* fds, long* node_loads, long* remote_loads) {
+    // a node access is a load served from memory, a node miss is one served by another node
+    long values[COUNTER_CNT] = {-1, -1};
+    for (int i = 0; i < COUNTER_CNT && fds[i] >= 0; i++) {
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fds[i], &values[i], sizeof(long)) != sizeof(long)) {
+            values[i] = -1;
+        }
+    }
+    *node_loads = values[0];
+    *remote_loads = values[0] >= 0 ? values[1] : -1;
+}
+
+void close_counters(int* fds) {
+    for (int i = 0; i < COUNTER_CNT; i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+        fds[i] = -1;
+    }
+}
@@ -0,0 +1,786 @@
+//
+// Joseph Prichard 2023
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "pipeline.h"
+
+static const char* DISPATCH_STRINGS[DISPATCH_CNT] = {"lpt", "input"};
+
+// RING IMPLEMENTATION
+
+int init_mpmc(mpmc_ring* ring, size_t capacity) {
+    // capacity is a power of two so positions wrap with a mask
+    ring->cells = malloc(sizeof(mpmc_cell) * capacity);
+    if (ring->cells == NULL) {
+        return 1;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&ring->cells[i].seq, i);
+    }
+    ring->mask = capacity - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return 0;
+}
+
+int mpmc_push(mpmc_ring* ring, const batch_job* job) {
+    // returns 1 if the ring is full
+    size_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    mpmc_cell* cell;
+    for (;;) {
+        cell = &ring->cells[pos & ring->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        long diff = (long) seq - (long) pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return 1;
+        } else {
+            pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        }
+    }
+    cell->job = *job;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    return 0;
+}
+
+int mpmc_pop(mpmc_ring* ring, batch_job* job) {
+    // returns 1 if the ring is empty
+    size_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    mpmc_cell* cell;
+    for (;;) {
+        cell = &ring->cells[pos & ring->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        long diff = (long) seq - (long) (pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return 1;
+        } else {
+            pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        }
+    }
+    *job = cell->job;
+    // free the cell for the producer one lap ahead
+    atomic_store_explicit(&cell->seq, pos + ring->mask + 1, memory_order_release);
+    return 0;
+}
+
+void free_mpmc(mpmc_ring* ring) {
+    free(ring->cells);
+}
+
+int init_spsc(spsc_ring* ring, size_t capacity) {
+    ring->slots = malloc(sizeof(batch_result) * capacity);
+    if (ring->slots == NULL) {
+        return 1;
+    }
+    ring->mask = capacity - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return 0;
+}
+
+int spsc_push(spsc_ring* ring, const batch_result* res) {
+    // returns 1 if the ring is full
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) > ring->mask) {
+        return 1;
+    }
+    ring->slots[head & ring->mask] = *res;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return 0;
+}
+
+batch_result* spsc_peek(spsc_ring* ring) {
+    // the oldest result stays in the ring until spsc_advance, so the consumer can decide whether to take it
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&ring->head, memory_order_acquire)) {
+        return NULL;
+    }
+    return &ring->slots[tail & ring->mask];
+}
+
+void spsc_advance(spsc_ring* ring) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+void free_spsc(spsc_ring* ring) {
+    free(ring->slots);
+}
+
+void backoff(int* spins) {
+    // yield while the wait is short, then sleep so a stalled stage doesn't burn a core others could use
+    if (++*spins < 64) {
+        sched_yield();
+    } else {
+        struct timespec delay = {0, 50000};
+        nanosleep(&delay, NULL);
+    }
+}
+
+// I/O IMPLEMENTATION
+
+static int is_regular(int fd) {
+    // io_uring reads and writes at explicit offsets, which pipes and terminals don't have
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+static int setup_blocks(uring* ring, char* blocks, size_t block_size) {
+    struct iovec iovecs[BATCH_IO_DEPTH];
+    for (int i = 0; i < BATCH_IO_DEPTH; i++) {
+        iovecs[i].iov_base = blocks + i * block_size;
+        iovecs[i].iov_len = block_size;
+    }
+    if (init_uring(ring, URING_ENTRIES) != 0) {
+        return 1;
+    }
+    if (register_buffers(ring, iovecs, BATCH_IO_DEPTH) != 0) {
+        free_uring(ring);
+        return 1;
+    }
+    return 0;
+}
+
+static int queue_block(uring* ring, int write, int fd, char* buf, unsigned len, long long offset, int slot,
+                       unsigned long long user_data) {
+    // the kernel frees the entries it consumes, so a full submission queue is submitted once to make room
+    if (queue_fixed(ring, write, fd, buf, len, offset, slot, user_data) == 0) {
+        return 0;
+    }
+    return enter_uring(ring, 0) != 0 || queue_fixed(ring, write, fd, buf, len, offset, slot, user_data) != 0;
+}
+
+static void queue_read(batch_reader* rd, long block) {
+    // reads the part of the block not filled yet, a read that can't be queued fails the block
+    int slot = (int) (block % BATCH_IO_DEPTH);
+    int filled = rd->lens[slot];
+    if (queue_block(&rd->ring, 0, rd->fd, rd->blocks + slot * BATCH_READ_SIZE + filled, BATCH_READ_SIZE - filled,
+                    (long long) block * BATCH_READ_SIZE + filled, slot, (unsigned long long) block) != 0) {
+        rd->lens[slot] = -1;
+        return;
+    }
+    rd->pending[slot] = 1;
+    rd->in_flight++;
+}
+
+static void start_read(batch_reader* rd, long block) {
+    rd->lens[block % BATCH_IO_DEPTH] = 0;
+    queue_read(rd, block);
+}
+
+static int reap_read(batch_reader* rd) {
+    // a read queued again here is submitted by the next enter
+    uring_completion done;
+    if (pop_completion(&rd->ring, &done) != 0) {
+        return enter_uring(&rd->ring, 1);
+    }
+    long block = (long) done.user_data;
+    int slot = (int) (block % BATCH_IO_DEPTH);
+    rd->pending[slot] = 0;
+    rd->in_flight--;
+    if (done.res == -EINTR || done.res == -EAGAIN) {
+        queue_read(rd, block);
+    } else if (done.res < 0) {
+        rd->lens[slot] = -1;
+    } else if (done.res > 0 && rd->lens[slot] + done.res < BATCH_READ_SIZE) {
+        // a read can come up short anywhere, only a read of nothing is the end of the file
+        rd->lens[slot] += done.res;
+        queue_read(rd, block);
+    } else {
+        rd->lens[slot] += done.res;
+    }
+    return 0;
+}
+
+int open_reader(batch_reader* rd, const char* path, int use_uring) {
+    memset(rd, 0, sizeof(batch_reader));
+    rd->last_block = -1;
+    rd->fd = open(path, O_RDONLY);
+    if (rd->fd < 0) {
+        return 1;
+    }
+    use_uring = use_uring && is_regular(rd->fd);
+    rd->blocks = aligned_alloc(4096, (size_t) BATCH_READ_SIZE * (use_uring ? BATCH_IO_DEPTH : 1));
+    if (rd->blocks == NULL) {
+        close(rd->fd);
+        return 1;
+    }
+    if (use_uring && setup_blocks(&rd->ring, rd->blocks, BATCH_READ_SIZE) != 0) {
+        rd->uring_failed = 1;
+        use_uring = 0;
+    }
+    rd->use_uring = use_uring;
+    if (use_uring) {
+        // start reading ahead right away, the parser then only waits for the blocks the disk hasn't caught up on
+        for (long block = 0; block < BATCH_IO_DEPTH; block++) {
+            start_read(rd, block);
+        }
+    }
+    return 0;
+}
+
+int read_block(batch_reader* rd, const char** data) {
+    // returns the length of the next block in file order, 0 at the end of the file or -1 on an error
+    if (!rd->use_uring) {
+        ssize_t n;
+        while ((n = read(rd->fd, rd->blocks, BATCH_READ_SIZE)) < 0 && errno == EINTR) {
+        }
+        *data = rd->blocks;
+        return (int) n;
+    }
+    if (rd->held) {
+        // the parser is done with the previous block, its buffer reads the block one depth ahead
+        rd->held = 0;
+        if (rd->last_block < 0) {
+            start_read(rd, rd->next_block - 1 + BATCH_IO_DEPTH);
+        }
+    }
+    if (rd->last_block >= 0 && rd->next_block > rd->last_block) {
+        return 0;
+    }
+    int slot = (int) (rd->next_block % BATCH_IO_DEPTH);
+    if (enter_uring(&rd->ring, 0) != 0) {
+        return -1;
+    }
+    while (rd->pending[slot]) {
+        if (reap_read(rd) != 0) {
+            return -1;
+        }
+    }
+    // short reads were resubmitted for the rest of the block, so a short block is the end of the file
+    int n = rd->lens[slot];
+    if (n < 0) {
+        return -1;
+    }
+    if (n < BATCH_READ_SIZE) {
+        rd->last_block = rd->next_block;
+    }
+    rd->next_block++;
+    rd->held = 1;
+    *data = rd->blocks + slot * BATCH_READ_SIZE;
+    return n;
+}
+
+void close_reader(batch_reader* rd) {
+    // the kernel writes into the blocks until their reads complete, so they can't be freed before
+    if (rd->use_uring) {
+        while (rd->in_flight > 0 && reap_read(rd) == 0) {
+        }
+        free_uring(&rd->ring);
+    }
+    free(rd->blocks);
+    close(rd->fd);
+}
+
+static int reap_write(batch_writer* wr) {
+    uring_completion done;
+    if (pop_completion(&wr->ring, &done) != 0) {
+        return enter_uring(&wr->ring, 1);
+    }
+    int slot = (int) done.user_data;
+    const char* block = wr->blocks + slot * BATCH_WRITE_SIZE;
+    if (done.res < 0) {
+        wr->err = 1;
+    } else if ((size_t) done.res < wr->lens[slot]) {
+        // a short write is finished synchronously, later blocks are at their own offsets so order doesn't matter
+        wr->err |= pwrite_all(wr->fd, block + done.res, wr->lens[slot] - done.res, wr->offsets[slot] + done.res);
+    }
+    wr->pending[slot] = 0;
+    wr->in_flight--;
+    return 0;
+}
+
+int open_writer(batch_writer* wr, const char* path, int use_uring) {
+    // NULL writes to stdout
+    memset(wr, 0, sizeof(batch_writer));
+    wr->fd = path != NULL ? open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644) : STDOUT_FILENO;
+    if (wr->fd < 0) {
+        return 1;
+    }
+    use_uring = use_uring && is_regular(wr->fd);
+    wr->blocks = aligned_alloc(4096, (size_t) BATCH_WRITE_SIZE * (use_uring ? BATCH_IO_DEPTH : 1));
+    if (wr->blocks == NULL) {
+        if (wr->fd != STDOUT_FILENO) {
+            close(wr->fd);
+        }
+        return 1;
+    }
+    if (use_uring && setup_blocks(&wr->ring, wr->blocks, BATCH_WRITE_SIZE) != 0) {
+        wr->uring_failed = 1;
+        use_uring = 0;
+    }
+    wr->use_uring = use_uring;
+    return 0;
+}
+
+char* writer_block(batch_writer* wr) {
+    return wr->blocks + wr->current * BATCH_WRITE_SIZE;
+}
+
+int write_block(batch_writer* wr, size_t len) {
+    // writes the current block, then waits only if the block after it is still being written
+    if (!wr->use_uring) {
+        return write_all(wr->fd, wr->blocks, len);
+    }
+    int slot = wr->current;
+    if (queue_block(&wr->ring, 1, wr->fd, writer_block(wr), (unsigned) len, wr->offset, slot,
+                    (unsigned long long) slot) != 0) {
+        return 1;
+    }
+    wr->lens[slot] = len;
+    wr->offsets[slot] = wr->offset;
+    wr->pending[slot] = 1;
+    wr->in_flight++;
+    wr->offset += (long long) len;
+    if (enter_uring(&wr->ring, 0) != 0) {
+        return 1;
+    }
+    wr->current = (wr->current + 1) % BATCH_IO_DEPTH;
+    while (wr->pending[wr->current] && !wr->err) {
+        if (reap_write(wr) != 0) {
+            return 1;
+        }
+    }
+    return wr->err;
+}
+
+int close_writer(batch_writer* wr) {
+    int err = wr->err;
+    if (wr->use_uring) {
+        while (wr->in_flight > 0 && !err) {
+            err = reap_write(wr);
+        }
+        err |= wr->err;
+        free_uring(&wr->ring);
+    }
+    free(wr->blocks);
+    if (wr->fd != STDOUT_FILENO) {
+        err |= close(wr->fd) != 0;
+    }
+    return err;
+}
+
+// STAGE IMPLEMENTATION
+
+int parse_line(const char* line, int len) {
+    // the digits of one board with any spacing, returns its rank, LINE_INVALID or LINE_BLANK
+    board brd;
+    int count = 0;
+    for (int i = 0; i < len; i++) {
+        if (isdigit((unsigned char) line[i])) {
+            if (count == SIZE) {
+                return LINE_INVALID;
+            }
+            brd[count++] = (tile) (line[i] - '0');
+        } else if (!isspace((unsigned char) line[i])) {
+            return LINE_INVALID;
+        }
+    }
+    if (count == 0) {
+        return LINE_BLANK;
+    }
+    return count == SIZE && is_valid_board(brd) ? rank_board(brd) : LINE_INVALID;
+}
+
+void push_job(batch_pipeline* pl, long seq, int rank) {
+    // backpressure, the parser waits while the solvers are a full ring behind
+    batch_job job = {seq, rank};
+    int spins = 0;
+    while (mpmc_push(&pl->jobs, &job) != 0 && !atomic_load(&pl->aborted)) {
+        backoff(&spins);
+    }
+}
+
+int estimate_job(const batch_pipeline* pl, int rank) {
+    if (rank < 0) {
+        return -1;
+    }
+    if (pl->opts->distances != NULL) {
+        int dist = pl->opts->distances[rank];
+        return dist != UNREACHABLE ? dist : -1;
+    }
+    board brd;
+    unrank_board(rank, brd);
+    return estimate_moves(brd, pl->goal, pl->opts->heuristic);
+}
+
+void flush_jobs(batch_pipeline* pl, job_chunk* chunk) {
+    // a chunk is only dispatched once it fits in the writer's window, so the writer takes every result whatever order
+    // it is solved in. otherwise a worker could hold the next line behind a result the writer won't take yet
+    if (chunk->cnt == 0) {
+        return;
+    }
+    long end = chunk->jobs[chunk->cnt - 1].seq + 1;
+    int spins = 0;
+    while (end - atomic_load_explicit(&pl->written, memory_order_acquire) > REORDER_WINDOW
+           && !atomic_load(&pl->aborted)) {
+        backoff(&spins);
+    }
+    // counting sort on the estimate, hardest first and in input order among equals so the writer still moves steadily
+    int starts[LONGEST_SOL + 2] = {0};
+    for (int i = 0; i < chunk->cnt; i++) {
+        starts[chunk->keys[i] + 1]++;
+    }
+    int offset = 0;
+    for (int key = LONGEST_SOL + 1; key >= 0; key--) {
+        int cnt = starts[key];
+        starts[key] = offset;
+        offset += cnt;
+    }
+    for (int i = 0; i < chunk->cnt; i++) {
+        chunk->sorted[starts[chunk->keys[i] + 1]++] = chunk->jobs[i];
+    }
+    for (int i = 0; i < chunk->cnt; i++) {
+        push_job(pl, chunk->sorted[i].seq, chunk->sorted[i].rank);
+    }
+    chunk->cnt = 0;
+}
+
+void add_job(batch_pipeline* pl, job_chunk* chunk, long seq, int rank) {
+    // a hard board dispatched last leaves every other worker idle while it is solved, so boards are held back and
+    // dispatched longest first, which brings the batch's time close to the total work divided by the workers
+    if (pl->opts->dispatch == DISPATCH_INPUT) {
+        push_job(pl, seq, rank);
+        return;
+    }
+    int key = estimate_job(pl, rank);
+    chunk->jobs[chunk->cnt] = (batch_job) {seq, rank};
+    chunk->keys[chunk->cnt] = (signed char) (key < LONGEST_SOL ? key : LONGEST_SOL);
+    if (++chunk->cnt == DISPATCH_CHUNK) {
+        flush_jobs(pl, chunk);
+    }
+}
+
+void* parse_stage(void* arg) {
+    batch_pipeline* pl = arg;
+    place_io_thread(pl->workers);
+    job_chunk* chunk = malloc(sizeof(job_chunk));
+    if (chunk == NULL) {
+        printf("Failed to allocate the batch parser\n");
+        atomic_store(&pl->aborted, 1);
+        atomic_store_explicit(&pl->parsed, 1, memory_order_release);
+        return NULL;
+    }
+    chunk->cnt = 0;
+    const char* buf;
+    char line[BATCH_LINE_MAX];
+    int len = 0;
+    long seq = 0;
+    int n = -1;
+    int rank;
+    while (!atomic_load(&pl->aborted) && (n = read_block(&pl->reader, &buf)) > 0) {
+        for (int i = 0; i < n; i++) {
+            if (buf[i] != '\n') {
+                // a line longer than the buffer can't hold a board, its last character is overwritten so it is rejected
+                if (len < BATCH_LINE_MAX) {
+                    line[len++] = buf[i];
+                } else {
+                    line[BATCH_LINE_MAX - 1] = 'x';
+                }
+                continue;
+            }
+            if ((rank = parse_line(line, len)) != LINE_BLANK) {
+                add_job(pl, chunk, seq++, rank);
+            }
+            len = 0;
+        }
+    }
+    if (n < 0) {
+        printf("Failed to read the batch input\n");
+        atomic_store(&pl->aborted, 1);
+    } else if (n == 0 && (rank = parse_line(line, len)) != LINE_BLANK) {
+        // the last line may not end with a newline
+        add_job(pl, chunk, seq++, rank);
+    }
+    flush_jobs(pl, chunk);
+    free(chunk);
+    atomic_store(&pl->total, seq);
+    atomic_store_explicit(&pl->parsed, 1, memory_order_release);
+    return NULL;
+}
+
+void* solve_stage(void* arg) {
+    batch_pipeline* pl = arg;
+    int worker = atomic_fetch_add(&pl->next_worker, 1);
+    spsc_ring* results = &pl->results[worker];
+    int node;
+    solver_ctx* ctx = NULL;
+    if (place_worker(pl->workers, worker, &node) != 0 || (ctx = new_solver(0)) == NULL
+        || (pl->workers->numa && set_solver_numa_node(ctx, node) != 0)) {
+        printf("Failed to start solver worker %d\n", worker);
+        if (ctx != NULL) {
+            free_solver(ctx);
+        }
+        // the batch can't finish once no worker is left
+        if (atomic_fetch_sub(&pl->live_workers, 1) == 1) {
+            atomic_store(&pl->aborted, 1);
+        }
+        return NULL;
+    }
+    set_solver_heuristic(ctx, pl->opts->heuristic);
+    set_solver_algorithm(ctx, pl->opts->algorithm);
+    set_solver_pruning(ctx, pl->opts->pruning);
+    set_solver_table(ctx, pl->opts->distances);
+    set_solver_timeout(ctx, pl->opts->timeout_ms);
+    set_solver_trace(ctx, trace_thread(pl->opts->trace, worker));
+
+    int spins = 0;
+    while (!atomic_load(&pl->aborted)) {
+        // read the flag before popping, so an empty ring after it means every job has been taken
+        int parsed = atomic_load_explicit(&pl->parsed, memory_order_acquire);
+        batch_job job;
+        if (mpmc_pop(&pl->jobs, &job) != 0) {
+            if (parsed) {
+                break;
+            }
+            backoff(&spins);
+            continue;
+        }
+        spins = 0;
+        batch_result res = {job.seq, job.rank, INVALID_BOARD, 0, 0, {0}};
+        if (job.rank >= 0) {
+            board brd;
+            unrank_board(job.rank, brd);
+            move moves[LONGEST_SOL];
+            solve_stats stats;
+            res.status = solve(ctx, brd, pl->goal, moves, &stats);
+            res.expanded = stats.expanded;
+            if (res.status == SOLVED) {
+                res.steps = stats.steps;
+                for (int i = 0; i < stats.steps; i++) {
+                    res.moves[i] = move_name(moves[i])[0];
+                }
+            }
+        }
+        // backpressure, the writer leaves results too far ahead of its next one in the ring
+        while (spsc_push(results, &res) != 0 && !atomic_load(&pl->aborted)) {
+            backoff(&spins);
+        }
+    }
+    free_solver(ctx);
+    atomic_fetch_sub(&pl->live_workers, 1);
+    return NULL;
+}
+
+int format_result(const batch_result* res, char* out) {
+    // "number board status steps moves", with - for a board that couldn't be read or a path that wasn't found
+    int len = sprintf(out, "%ld ", res->seq + 1);
+    if (res->rank >= 0) {
+        board brd;
+        unrank_board(res->rank, brd);
+        for (int i = 0; i < SIZE; i++) {
+            out[len++] = (char) ('0' + brd[i]);
+        }
+    } else {
+        out[len++] = '-';
+    }
+    len += sprintf(out + len, " %s %d ", status_name(res->status), res->steps);
+    if (res->steps > 0) {
+        memcpy(out + len, res->moves, res->steps);
+        len += res->steps;
+    } else {
+        out[len++] = '-';
+    }
+    out[len++] = '\n';
+    return len;
+}
+
+int write_all(int fd, const char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 1;
+        }
+        buf += n;
+        len -= (size_t) n;
+    }
+    return 0;
+}
+
+int pwrite_all(int fd, const char* buf, size_t len, long long offset) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, buf, len, (off_t) offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 1;
+        }
+        buf += n;
+        len -= (size_t) n;
+        offset += n;
+    }
+    return 0;
+}
+
+int write_stage(batch_pipeline* pl, long* solved, long* expanded) {
+    // results arrive in any order, they wait in a window indexed by sequence number until every earlier one is out
+    batch_result* window = malloc(sizeof(batch_result) * REORDER_WINDOW);
+    char* present = calloc(REORDER_WINDOW, 1);
+    char* out = writer_block(&pl->writer);
+    int err = window == NULL || present == NULL;
+    size_t out_len = 0;
+    long next = 0;
+    int spins = 0;
+    while (!err) {
+        int progress = 0;
+        for (int w = 0; w < pl->workers->thread_cnt; w++) {
+            // results too far ahead stay in their ring, which backs up the worker that produced them
+            batch_result* res;
+            while ((res = spsc_peek(&pl->results[w])) != NULL && res->seq < next + REORDER_WINDOW) {
+                window[res->seq & (REORDER_WINDOW - 1)] = *res;
+                present[res->seq & (REORDER_WINDOW - 1)] = 1;
+                spsc_advance(&pl->results[w]);
+                progress = 1;
+            }
+        }
+        while (!err && present[next & (REORDER_WINDOW - 1)]) {
+            const batch_result* res = &window[next & (REORDER_WINDOW - 1)];
+            if (out_len + BATCH_LINE_MAX > BATCH_WRITE_SIZE) {
+                err = write_block(&pl->writer, out_len);
+                out = writer_block(&pl->writer);
+                out_len = 0;
+            }
+            out_len += format_result(res, out + out_len);
+            *solved += res->status == SOLVED;
+            *expanded += res->expanded;
+            present[next & (REORDER_WINDOW - 1)] = 0;
+            next++;
+            progress = 1;
+        }
+        atomic_store_explicit(&pl->written, next, memory_order_release);
+        if (atomic_load_explicit(&pl->parsed, memory_order_acquire) && next == atomic_load(&pl->total)) {
+            break;
+        }
+        if (atomic_load(&pl->aborted)) {
+            err = 1;
+        } else if (progress) {
+            spins = 0;
+        } else {
+            backoff(&spins);
+        }
+    }
+    if (!err && out_len > 0) {
+        err = write_block(&pl->writer, out_len);
+    }
+    free(window);
+    free(present);
+    return err;
+}
+
+int parse_dispatch(const char* name, batch_dispatch* dispatch) {
+    for (int i = 0; i < DISPATCH_CNT; i++) {
+        if (strcmp(name, DISPATCH_STRINGS[i]) == 0) {
+            *dispatch = (batch_dispatch) i;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int run_batch(const board goal_brd, const batch_opts* opts, const worker_opts* workers) {
+    int thread_cnt = workers->thread_cnt;
+    batch_pipeline pl;
+    pl.opts = opts;
+    pl.workers = workers;
+    pl.goal = goal_brd;
+    atomic_init(&pl.next_worker, 0);
+    atomic_init(&pl.live_workers, thread_cnt);
+    atomic_init(&pl.parsed, 0);
+    atomic_init(&pl.total, 0);
+    atomic_init(&pl.written, 0);
+    atomic_init(&pl.aborted, 0);
+    pl.jobs.cells = NULL;
+
+    if (open_reader(&pl.reader, opts->input_path, opts->uring) != 0) {
+        printf("Failed to open %s", opts->input_path);
+        return 1;
+    }
+    if (open_writer(&pl.writer, opts->output_path, opts->uring) != 0) {
+        printf("Failed to open %s", opts->output_path);
+        close_reader(&pl.reader);
+        return 1;
+    }
+    if (pl.reader.uring_failed || pl.writer.uring_failed) {
+        printf("io_uring is unavailable, falling back to read and write\n");
+    }
+    pl.results = aligned_alloc(CACHE_LINE, sizeof(spsc_ring) * thread_cnt);
+    pthread_t* threads = malloc(sizeof(pthread_t) * (thread_cnt + 1));
+    int err = pl.results == NULL || threads == NULL || init_mpmc(&pl.jobs, JOB_RING_CAP) != 0;
+    int ring_cnt = 0;
+    for (; !err && ring_cnt < thread_cnt; ring_cnt++) {
+        if (init_spsc(&pl.results[ring_cnt], RESULT_RING_CAP) != 0) {
+            err = 1;
+            break;
+        }
+    }
+    if (err) {
+        printf("Failed to allocate the pipeline");
+    }
+
+    double start = now_ns();
+    long solved = 0;
+    long expanded = 0;
+    // thread 0 parses and the rest solve, if one can't be started the ones that were are stopped and joined
+    int started = 0;
+    for (; !err && started < thread_cnt + 1; started++) {
+        if (pthread_create(&threads[started], NULL, started == 0 ? parse_stage : solve_stage, &pl) != 0) {
+            printf("Failed to start the batch threads\n");
+            err = 1;
+            break;
+        }
+    }
+    if (!err) {
+        // the writer runs on the main thread, placed after the workers so they don't inherit its affinity
+        place_io_thread(workers);
+        err = write_stage(&pl, &solved, &expanded);
+    }
+    if (err) {
+        atomic_store(&pl.aborted, 1);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    // the output is only complete once the writes in flight are
+    close_reader(&pl.reader);
+    err |= close_writer(&pl.writer);
+    double seconds = (now_ns() - start) / 1e9;
+
+    if (!err && opts->output_path != NULL) {
+        long total = atomic_load(&pl.total);
+        printf("Solved %ld of %ld boards in %.3f s: %.0f boards/s, %.0f expansions/s\n", solved, total, seconds,
+               (double) total / seconds, (double) expanded / seconds);
+    } else if (err) {
+        printf("Batch aborted\n");
+    }
+    for (int i = 0; i < ring_cnt; i++) {
+        free_spsc(&pl.results[i]);
+    }
+    free_mpmc(&pl.jobs);
+    free(pl.results);
+    free(threads);
+    return err;
+}
@@ -0,0 +1,198 @@
+//
+// Joseph Prichard 2023
+//
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdatomic.h>
+#include "bench.h"
+#include "uring.h"
+
+#define JOB_RING_CAP 1024
+#define RESULT_RING_CAP 256
+#define REORDER_WINDOW 4096
+#define BATCH_READ_SIZE 65536
+#define BATCH_WRITE_SIZE 65536
+#define BATCH_IO_DEPTH 4
+#define DISPATCH_CHUNK 1024
+#define BATCH_LINE_MAX 128
+#define CACHE_LINE 64
+#define LINE_INVALID -1
+#define LINE_BLANK -2
+#define DISPATCH_CNT 2
+
+// TYPE AND FUNCTION DEFINITIONS
+
+// a board of the input, numbered in input order so the writer can restore it
+typedef struct batch_job {
+    long seq;
+    int rank; // -1 if the line isn't a valid board
+} batch_job;
+
+typedef struct batch_result {
+    long seq;
+    int rank;
+    solve_status status;
+    int steps;
+    long expanded;
+    char moves[LONGEST_SOL]; // first letter of each move
+} batch_result;
+
+typedef struct mpmc_cell {
+    atomic_size_t seq; // equals the position when the cell is free for it, and position + 1 once it is filled
+    batch_job job;
+} mpmc_cell;
+
+// bounded multi producer multi consumer ring of jobs, producers and consumers claim positions with a cas
+typedef struct mpmc_ring {
+    mpmc_cell* cells;
+    size_t mask;
+    _Alignas(CACHE_LINE) atomic_size_t head; // next position to fill
+    _Alignas(CACHE_LINE) atomic_size_t tail; // next position to drain
+} mpmc_ring;
+
+// bounded single producer single consumer ring of results, each index is only written by its owner
+typedef struct spsc_ring {
+    batch_result* slots;
+    size_t mask;
+    _Alignas(CACHE_LINE) atomic_size_t head; // written by the producer
+    _Alignas(CACHE_LINE) atomic_size_t tail; // written by the consumer
+} spsc_ring;
+
+// the order boards are handed to the workers in, the output is always in input order
+typedef enum batch_dispatch {
+    DISPATCH_LPT, // longest processing time first, within chunks of the input
+    DISPATCH_INPUT
+} batch_dispatch;
+
+typedef struct batch_opts {
+    const char* input_path;
+    const char* output_path; // NULL writes to stdout
+    solve_algorithm algorithm;
+    solve_pruning pruning;
+    solve_heuristic heuristic;
+    long timeout_ms;
+    int uring; // read and write through io_uring when the file is a regular file
+    batch_dispatch dispatch;
+    const uint8_t* distances; // ranks boards by their true distance and is walked by a table lookup, NULL ranks by h
+    trace_writer* trace; // each worker traces its solves into a buffer of its own, NULL disables tracing
+} batch_opts;
+
+// boards parsed but not yet dispatched
+typedef struct job_chunk {
+    batch_job jobs[DISPATCH_CHUNK];
+    batch_job sorted[DISPATCH_CHUNK];
+    signed char keys[DISPATCH_CHUNK]; // estimated moves, or -1 for a board that won't be searched
+    int cnt;
+} job_chunk;
+
+// reads the input in blocks, with io_uring the next blocks are already being read while one is parsed
+typedef struct batch_reader {
+    int fd;
+    int use_uring;
+    int uring_failed; // io_uring was asked for but couldn't be set up
+    uring ring;
+    char* blocks; // BATCH_IO_DEPTH registered blocks with io_uring, one without
+    int lens[BATCH_IO_DEPTH];
+    char pending[BATCH_IO_DEPTH]; // a read into the block is in flight
+    int in_flight;
+    long next_block; // handed to the parser next
+    long last_block; // the first short block, nothing past it is read, or -1
+    int held; // the parser still has the previous block
+} batch_reader;
+
+// writes the output in blocks, with io_uring a block is filled while the ones before it are being written
+typedef struct batch_writer {
+    int fd;
+    int use_uring;
+    int uring_failed;
+    uring ring;
+    char* blocks;
+    size_t lens[BATCH_IO_DEPTH];
+    long long offsets[BATCH_IO_DEPTH];
+    char pending[BATCH_IO_DEPTH];
+    int in_flight;
+    int current; // the block being filled
+    long long offset; // file offset of the next block
+    int err;
+} batch_writer;
+
+// shared by the parser, the solver workers and the writer
+typedef struct batch_pipeline {
+    const batch_opts* opts;
+    const worker_opts* workers;
+    const tile* goal;
+    batch_reader reader;
+    batch_writer writer;
+    mpmc_ring jobs;
+    spsc_ring* results; // one per worker
+    atomic_int next_worker;
+    atomic_int live_workers;
+    atomic_int parsed; // every job has been pushed and total is final
+    atomic_long total;
+    atomic_long written; // every result before it is out
+    atomic_int aborted;
+} batch_pipeline;
+
+int init_mpmc(mpmc_ring*, size_t capacity);
+
+int mpmc_push(mpmc_ring*, const batch_job*);
+
+int mpmc_pop(mpmc_ring*, batch_job*);
+
+void free_mpmc(mpmc_ring*);
+
+int init_spsc(spsc_ring*, size_t capacity);
+
+int spsc_push(spsc_ring*, const batch_result*);
+
+batch_result* spsc_peek(spsc_ring*);
+
+void spsc_advance(spsc_ring*);
+
+void free_spsc(spsc_ring*);
+
+void backoff(int* spins);
+
+int open_reader(batch_reader*, const char* path, int use_uring);
+
+int read_block(batch_reader*, const char** data);
+
+void close_reader(batch_reader*);
+
+int open_writer(batch_writer*, const char* path, int use_uring);
+
+char* writer_block(batch_writer*);
+
+int write_block(batch_writer*, size_t len);
+
+int close_writer(batch_writer*);
+
+int parse_line(const char* line, int len);
+
+void push_job(batch_pipeline*, long seq, int rank);
+
+int estimate_job(const batch_pipeline*, int rank);
+
+void flush_jobs(batch_pipeline*, job_chunk*);
+
+void add_job(batch_pipeline*, job_chunk*, long seq, int rank);
+
+void* parse_stage(void*);
+
+void* solve_stage(void*);
+
+int format_result(const batch_result*, char* out);
+
+int write_all(int fd, const char* buf, size_t len);
+
+int pwrite_all(int fd, const char* buf, size_t len, long long offset);
+
+int write_stage(batch_pipeline*, long* solved, long* expanded);
+
+int parse_dispatch(const char* name, batch_dispatch*);
+
+int run_batch(const board goal_brd, const batch_opts*, const worker_opts*);
+
+#endif
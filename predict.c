@@ -0,0 +1,305 @@
+//
+// Joseph Prichard 2023
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "solver_internal.h"
+
+// HEURISTIC DISTRIBUTION IMPLEMENTATION
+
+uint64_t next_random(uint64_t* state) {
+    // xorshift64*, seeded with a constant so a prediction is the same on every run
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+void sample_heuristic(solver_ctx* ctx) {
+    // the transitions only depend on the goal and the heuristic, so they are sampled once for each
+    if (ctx->h_dist_heuristic == (int) ctx->heuristic && ctx->h_dist_goal == ctx->goal_hash) {
+        return;
+    }
+    double counts[LONGEST_SOL + 1][3] = {{0}};
+    uint64_t seed = HDIST_SEED;
+    for (int s = 0; s < HDIST_SAMPLES; s++) {
+        board brd;
+        for (int i = 0; i < SIZE; i++) {
+            brd[i] = (tile) i;
+        }
+        for (int i = SIZE - 1; i > 0; i--) {
+            int j = (int) (next_random(&seed) % (uint64_t) (i + 1));
+            tile temp = brd[i];
+            brd[i] = brd[j];
+            brd[j] = temp;
+        }
+        if (!is_solvable(brd, ctx->goal)) {
+            // swapping two tiles flips the parity and pairs each unsolvable board with one solvable board, so the
+            // samples stay uniform over the states reachable from the goal
+            int a = brd[0] != 0 ? 0 : 2;
+            int b = brd[1] != 0 ? 1 : 2;
+            tile temp = brd[a];
+            brd[a] = brd[b];
+            brd[b] = temp;
+        }
+        int h = estimate(ctx, brd);
+        if (h > LONGEST_SOL) {
+            continue;
+        }
+        for (int i = 0; i < NEIGHBOR_CNT; i++) {
+            board next_brd;
+            if (move_board(brd, next_brd, NEIGHBOR_OFFSETS[i][0], NEIGHBOR_OFFSETS[i][1]) == 0) {
+                counts[h][estimate(ctx, next_brd) - h + 1]++;
+            }
+        }
+    }
+    // a value no sample had borrows the transitions of the nearest one that did, they change slowly with h
+    double totals[LONGEST_SOL + 1];
+    for (int v = 0; v <= LONGEST_SOL; v++) {
+        totals[v] = counts[v][0] + counts[v][1] + counts[v][2];
+    }
+    for (int v = 0; v <= LONGEST_SOL; v++) {
+        int src = -1;
+        for (int dist = 0; src < 0 && dist <= LONGEST_SOL; dist++) {
+            if (v - dist >= 0 && totals[v - dist] > 0) {
+                src = v - dist;
+            } else if (v + dist <= LONGEST_SOL && totals[v + dist] > 0) {
+                src = v + dist;
+            }
+        }
+        for (int d = 0; d < 3; d++) {
+            ctx->h_next[v][d] = src >= 0 ? counts[src][d] / totals[src] : 1.0 / 3;
+        }
+    }
+    ctx->h_dist_goal = ctx->goal_hash;
+    ctx->h_dist_heuristic = (int) ctx->heuristic;
+}
+
+// TREE SIZE IMPLEMENTATION
+
+void count_move_tree(int blank, int prune_inverse, double* sizes) {
+    // paths by the blank's position and the neighbor index of the last move, NEIGHBOR_CNT for the root
+    double paths[SIZE][NEIGHBOR_CNT + 1] = {{0}};
+    paths[blank][NEIGHBOR_CNT] = 1;
+    for (int depth = 0; depth <= LONGEST_SOL; depth++) {
+        double next[SIZE][NEIGHBOR_CNT + 1] = {{0}};
+        sizes[depth] = 0;
+        for (int p = 0; p < SIZE; p++) {
+            for (int last = 0; last <= NEIGHBOR_CNT; last++) {
+                if (paths[p][last] == 0) {
+                    continue;
+                }
+                sizes[depth] += paths[p][last];
+                for (int i = 0; i < NEIGHBOR_CNT; i++) {
+                    int row = p / ROWS + NEIGHBOR_OFFSETS[i][0];
+                    int col = p % ROWS + NEIGHBOR_OFFSETS[i][1];
+                    if (row < 0 || row >= ROWS || col < 0 || col >= ROWS
+                        || (prune_inverse && last < NEIGHBOR_CNT
+                            && NEIGHBOR_MOVES[i] == INVERSE_MOVES[NEIGHBOR_MOVES[last]])) {
+                        continue;
+                    }
+                    next[row * ROWS + col][i] += paths[p][last];
+                }
+            }
+        }
+        memcpy(paths, next, sizeof(paths));
+    }
+}
+
+int count_fsm_tree(const fsm* pruner, int blank, double* sizes) {
+    // the transitions that are neither illegal nor pruned are exactly the moves IDA* follows
+    double* paths = calloc(pruner->node_cnt, sizeof(double));
+    double* next = calloc(pruner->node_cnt, sizeof(double));
+    if (paths == NULL || next == NULL) {
+        free(paths);
+        free(next);
+        return 1;
+    }
+    paths[pruner->roots[blank]] = 1;
+    for (int depth = 0; depth <= LONGEST_SOL; depth++) {
+        sizes[depth] = 0;
+        memset(next, 0, sizeof(double) * pruner->node_cnt);
+        for (int u = 0; u < pruner->node_cnt; u++) {
+            if (paths[u] == 0) {
+                continue;
+            }
+            sizes[depth] += paths[u];
+            for (int i = 0; i < NEIGHBOR_CNT; i++) {
+                int v = pruner->next[u][i];
+                if (v >= 0) {
+                    next[v] += paths[u];
+                }
+            }
+        }
+        double* temp = paths;
+        paths = next;
+        next = temp;
+    }
+    free(paths);
+    free(next);
+    return 0;
+}
+
+int count_tree(solver_ctx* ctx, int blank) {
+    // the level sizes only depend on the blank position and the pruning, so each is counted once
+    if (ctx->pruner == NULL && (ctx->pruner = new_fsm(&ctx->budget)) == NULL) {
+        return 1;
+    }
+    if (!ctx->graph_counted[blank]) {
+        if (count_fsm_tree(ctx->pruner, blank, ctx->graph_sizes[blank]) != 0) {
+            return 1;
+        }
+        ctx->graph_counted[blank] = 1;
+    }
+    if (ctx->tree_pruning[blank] != (int) ctx->pruning) {
+        if (ctx->pruning == PRUNE_FSM) {
+            memcpy(ctx->tree_sizes[blank], ctx->graph_sizes[blank], sizeof(ctx->tree_sizes[blank]));
+        } else {
+            count_move_tree(blank, ctx->pruning == PRUNE_INVERSE, ctx->tree_sizes[blank]);
+        }
+        ctx->tree_pruning[blank] = (int) ctx->pruning;
+    }
+    return 0;
+}
+
+// PREDICTION IMPLEMENTATION
+
+double predict_iteration(const solver_ctx* ctx, const double* sizes, int h, int threshold) {
+    // the KRE formula conditioned on the parent's h (CDP): the nodes at each depth are counted by h, starting from the
+    // root's, and a node within the threshold spreads its children over h - 1, h and h + 1 by the sampled chances.
+    // unlike the plain formula it follows where the search starts, so it doesn't assume each depth has the h of all
+    // states. the branching at each depth is the brute force tree's
+    double level[LONGEST_SOL + 2] = {0};
+    double nodes = 0;
+    level[h < LONGEST_SOL ? h : LONGEST_SOL] = 1;
+    for (int i = 0; i <= threshold && i <= LONGEST_SOL; i++) {
+        double next[LONGEST_SOL + 2] = {0};
+        double branching = i < LONGEST_SOL && sizes[i] > 0 ? sizes[i + 1] / sizes[i] : 0;
+        for (int v = 0; v <= threshold - i && v <= LONGEST_SOL; v++) {
+            if (level[v] == 0) {
+                continue;
+            }
+            nodes += level[v];
+            double children = level[v] * branching;
+            if (v > 0) {
+                next[v - 1] += children * ctx->h_next[v][0];
+            }
+            next[v] += children * ctx->h_next[v][1];
+            next[v + 1] += children * ctx->h_next[v][2];
+        }
+        memcpy(level, next, sizeof(level));
+    }
+    return nodes;
+}
+
+double predict_ida(const solver_ctx* ctx, int blank, int h, int depth) {
+    // every iteration up to the one at the solution's depth, manhattan distance changes f by 2 at a time. the goal
+    // is found halfway through the last iteration on average
+    int step = ctx->heuristic == MANHATTAN ? 2 : 1;
+    double nodes = 0;
+    for (int threshold = h; threshold <= depth; threshold += step) {
+        nodes += predict_iteration(ctx, ctx->tree_sizes[blank], h, threshold) * (threshold + step > depth ? 0.5 : 1);
+    }
+    return nodes;
+}
+
+double predict_astar(const solver_ctx* ctx, int blank, int h, int depth) {
+    // A* expands each state at most once, so its tree is the fsm pruned one whatever IDA* prunes with, capped by the
+    // states of the goal's parity. below that the duplicates the fsm misses are still counted
+    double nodes = predict_iteration(ctx, ctx->graph_sizes[blank], h, depth);
+    return nodes < PERM_CNT / 2 ? nodes : PERM_CNT / 2;
+}
+
+int prefer_astar(const solver_ctx* ctx, int threshold) {
+    // the solution is at least threshold long, so the next iteration of IDA* is weighed against all of A* at that
+    // depth. A* expands no more than the tree does, so while the whole brute force tree is cheaper than A* at its cap
+    // IDA* wins without a prediction
+    int blank = find_zero(ctx->initial);
+    const double* sizes = ctx->tree_sizes[blank];
+    double tree = 0;
+    for (int i = 0; i <= threshold && i <= LONGEST_SOL; i++) {
+        tree += sizes[i];
+    }
+    if (tree * IDA_NODE_COST <= PERM_CNT / 2 * ASTAR_NODE_COST) {
+        return 0;
+    }
+    int h = estimate(ctx, ctx->initial);
+    return predict_iteration(ctx, sizes, h, threshold) * IDA_NODE_COST
+           > predict_astar(ctx, blank, h, threshold) * ASTAR_NODE_COST;
+}
+
+int has_table(const solver_ctx* ctx) {
+    return ctx->table != NULL && ctx->table[rank_board(ctx->goal)] == 0;
+}
+
+solve_algorithm select_algorithm(solver_ctx* ctx) {
+    // IDA* is cheaper per expansion and rejects unsolvable boards up front, so it is the default unless the tree
+    // is predicted to outgrow A*. step_ida checks again before each deeper iteration
+    if (has_table(ctx)) {
+        return TABLE_LOOKUP;
+    }
+    if (!is_solvable(ctx->initial, ctx->goal)) {
+        return IDASTAR;
+    }
+    sample_heuristic(ctx);
+    if (count_tree(ctx, find_zero(ctx->initial)) != 0) {
+        return ASTAR;
+    }
+    return prefer_astar(ctx, estimate(ctx, ctx->initial)) ? ASTAR : IDASTAR;
+}
+
+solve_status walk_table(solver_ctx* ctx) {
+    // each step moves to a neighbor one closer to the goal, so only the states on the path are expanded
+    int dist = ctx->table[rank_board(ctx->initial)];
+    if (dist == UNREACHABLE) {
+        return UNSOLVABLE;
+    }
+    board brd;
+    memcpy(brd, ctx->initial, sizeof(board));
+    for (int step = 0; step < dist && step < LONGEST_SOL; step++) {
+        ctx->stats.expanded++;
+        int found = 0;
+        for (int i = 0; i < NEIGHBOR_CNT && !found; i++) {
+            board next_brd;
+            if (move_board(brd, next_brd, NEIGHBOR_OFFSETS[i][0], NEIGHBOR_OFFSETS[i][1]) != 0) {
+                continue;
+            }
+            ctx->stats.generated++;
+            if (ctx->table[rank_board(next_brd)] == dist - step - 1) {
+                ctx->path[step] = (move) NEIGHBOR_MOVES[i];
+                memcpy(brd, next_brd, sizeof(board));
+                found = 1;
+            }
+        }
+        // only a table that isn't a distance table for this goal has no neighbor one closer
+        if (!found) {
+            return INVALID_BOARD;
+        }
+    }
+    ctx->stats.steps = dist;
+    ctx->stats.f_bound = dist;
+    return SOLVED;
+}
+
+void record_prediction(solver_ctx* ctx) {
+    // predicted again at the depth the search turned out to need, so the error measures the model and not the guess
+    solve_stats* stats = &ctx->stats;
+    int blank = find_zero(ctx->initial);
+    if (ctx->status != SOLVED || ctx->active == TABLE_LOOKUP) {
+        return;
+    }
+    sample_heuristic(ctx);
+    if (count_tree(ctx, blank) != 0) {
+        return;
+    }
+    int h = estimate(ctx, ctx->initial);
+    double predicted = ctx->active == IDASTAR
+        ? predict_ida(ctx, blank, h, stats->steps)
+        : predict_astar(ctx, blank, h, stats->steps);
+    long expanded = stats->expanded - ctx->switch_expanded;
+    stats->predicted = (long) (predicted + 0.5);
+    stats->prediction_error = expanded > 0 ? predicted / (double) expanded - 1 : 0;
+}
@@ -0,0 +1,29 @@
+//
+// Joseph Prichard 2023
+//
+
+#ifndef PUZZLE_API_H
+#define PUZZLE_API_H
+
+// the major version changes whenever the ABI breaks, public structs only ever grow at the end within a major version.
+// this is the only place the version is set, the build reads it from here to name the shared library
+#define PUZZLE_VERSION_MAJOR 1
+#define PUZZLE_VERSION_MINOR 10
+#define PUZZLE_VERSION_PATCH 0
+
+// the library is built with hidden visibility, only declarations marked with this are exported
+#if defined(__GNUC__)
+#define PUZZLE_API __attribute__((visibility("default")))
+#else
+#define PUZZLE_API
+#endif
+
+#ifdef __cplusplus
+#define PUZZLE_BEGIN_DECLS extern "C" {
+#define PUZZLE_END_DECLS }
+#else
+#define PUZZLE_BEGIN_DECLS
+#define PUZZLE_END_DECLS
+#endif
+
+#endif
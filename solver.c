@@ -0,0 +1,1264 @@
+//
+// Joseph Prichard 2023
+//
+
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "solver_internal.h"
+
+// GLOBALS
+
+static const char* MOVE_STRINGS[] = {"Start", "Up", "Down", "Left", "Right"};
+
+static const char* STATUS_STRINGS[] = {"solved", "unsolvable", "out_of_memory", "invalid_board", "timed_out", "cancelled",
+                                       "in_progress"};
+
+static const char* PAGE_MODE_STRINGS[] = {"default", "small", "transparent", "hugetlb"};
+
+static const char* ALGORITHM_STRINGS[ALGORITHM_CNT] = {"astar", "idastar", "table", "auto"};
+
+static const char* HEURISTIC_STRINGS[HEURISTIC_CNT] = {"manhattan", "misplaced"};
+
+static const char* PRUNING_STRINGS[PRUNING_CNT] = {"none", "inverse", "fsm"};
+
+#define STRINGIFY(x) #x
+#define VERSION_STRING(major, minor, patch) STRINGIFY(major) "." STRINGIFY(minor) "." STRINGIFY(patch)
+
+static const char* VERSION = VERSION_STRING(PUZZLE_VERSION_MAJOR, PUZZLE_VERSION_MINOR, PUZZLE_VERSION_PATCH);
+
+// MEMORY ACCOUNTING IMPLEMENTATION
+
+void reset_peak(mem_usage* mem) {
+    mem->peak = mem->current;
+}
+
+void update_usage(mem_usage* mem, size_t old_size, size_t new_size) {
+    mem->current = mem->current - old_size + new_size;
+    if (mem->current > mem->peak) {
+        mem->peak = mem->current;
+    }
+}
+
+void* realloc_tracked(void* ptr, size_t old_size, size_t new_size, mem_usage* mem, mem_budget* budget) {
+    // refuse to grow past the hard limit before asking the allocator
+    if (budget != NULL && budget->limit > 0 && budget->total.current - old_size + new_size > budget->limit) {
+        return NULL;
+    }
+    void* new_ptr = realloc(ptr, new_size);
+    if (new_ptr == NULL) {
+        return NULL;
+    }
+    update_usage(mem, old_size, new_size);
+    if (budget != NULL) {
+        update_usage(&budget->total, old_size, new_size);
+        budget->allocations++;
+    }
+    return new_ptr;
+}
+
+void free_tracked(void* ptr, size_t size, mem_usage* mem, mem_budget* budget) {
+    free(ptr);
+    update_usage(mem, size, 0);
+    if (budget != NULL) {
+        update_usage(&budget->total, size, 0);
+    }
+}
+
+int use_huge_pages(const mem_budget* budget, size_t size) {
+    // smaller structures would waste most of a huge page
+    return budget != NULL && budget->huge_pages && size >= HUGE_PAGE_SIZE / 2;
+}
+
+int use_mapping(const mem_budget* budget, size_t size) {
+    // on a NUMA node every structure is mapped whatever its size, so it can be bound before its first touch
+    return use_huge_pages(budget, size) || (budget != NULL && budget->numa_node >= 0);
+}
+
+size_t huge_page_round(size_t size) {
+    return (size + HUGE_PAGE_SIZE - 1) & ~(size_t) (HUGE_PAGE_SIZE - 1);
+}
+
+size_t mapping_size(const mem_budget* budget, size_t size) {
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    return use_huge_pages(budget, size) ? huge_page_round(size) : (size + page - 1) / page * page;
+}
+
+void* alloc_pages(size_t size, size_t* mapped, mem_usage* mem, mem_budget* budget) {
+    // *mapped is the length of the mapping, or 0 if the memory came from the heap
+    *mapped = use_mapping(budget, size) ? mapping_size(budget, size) : 0;
+    return *mapped > 0 ? map_pages(*mapped, mem, budget) : realloc_tracked(NULL, 0, size, mem, budget);
+}
+
+void free_pages(void* ptr, size_t size, size_t mapped, mem_usage* mem, mem_budget* budget) {
+    if (mapped > 0) {
+        unmap_pages(ptr, mapped, mem, budget);
+    } else {
+        free_tracked(ptr, size, mem, budget);
+    }
+}
+
+void* map_pages(size_t size, mem_usage* mem, mem_budget* budget) {
+    // a multiple of the huge page size tries the reserved pool first, then advises transparent huge pages
+    if (budget->limit > 0 && budget->total.current + size > budget->limit) {
+        return NULL;
+    }
+    int huge = budget->huge_pages && size % HUGE_PAGE_SIZE == 0;
+    page_mode mode = PAGES_HUGETLB;
+    void* ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (huge) {
+        ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (!huge) {
+        // only mapped to be bound to a node, small pages need no alignment
+        ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            return NULL;
+        }
+    } else if (ptr == MAP_FAILED) {
+        // over map by a huge page and trim to a boundary, the kernel only backs aligned ranges with huge pages
+        size_t span = size + HUGE_PAGE_SIZE;
+        char* raw = mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            return NULL;
+        }
+        char* aligned = (char*) huge_page_round((uintptr_t) raw);
+        if (aligned > raw) {
+            munmap(raw, aligned - raw);
+        }
+        if (raw + span > aligned + size) {
+            munmap(aligned + size, raw + span - (aligned + size));
+        }
+        ptr = aligned;
+        mode = PAGES_SMALL;
+#ifdef MADV_HUGEPAGE
+        if (madvise(ptr, size, MADV_HUGEPAGE) == 0) {
+            mode = PAGES_TRANSPARENT;
+        }
+#endif
+    }
+    // the policy must be set before the first touch faults the pages in
+    if (budget->numa_node >= 0 && bind_pages(ptr, size, budget->numa_node) != 0) {
+        budget->numa_failed = 1;
+    }
+    if (huge && (budget->pages == PAGES_DEFAULT || mode < budget->pages)) {
+        budget->pages = mode;
+    }
+    update_usage(mem, 0, size);
+    update_usage(&budget->total, 0, size);
+    budget->allocations++;
+    return ptr;
+}
+
+void unmap_pages(void* ptr, size_t size, mem_usage* mem, mem_budget* budget) {
+    munmap(ptr, size);
+    update_usage(mem, size, 0);
+    update_usage(&budget->total, size, 0);
+}
+
+const char* page_mode_name(page_mode mode) {
+    return mode >= PAGES_DEFAULT && mode <= PAGES_HUGETLB ? PAGE_MODE_STRINGS[mode] : "unknown";
+}
+
+// NODE STORE IMPLEMENTATION
+
+node_store* new_nodes(mem_budget* budget) {
+    node_store* ns = malloc(sizeof(node_store));
+    if (ns == NULL) {
+        return NULL;
+    }
+    ns->size = 0;
+    // with huge pages the block starts at one huge page of boards, smaller blocks wouldn't be mapped. under a limit
+    // that can't hold it, the block starts small and is only mapped if it grows that large
+    ns->capacity = NODE_INITIAL_CAP;
+    int huge_cap = HUGE_PAGE_SIZE / (int) sizeof(uint64_t);
+    if (budget != NULL && budget->huge_pages
+        && (budget->limit == 0 || budget->total.current + huge_page_round(NODE_SIZE * huge_cap) <= budget->limit)) {
+        ns->capacity = huge_cap;
+    }
+    ns->mem = (mem_usage) {0};
+    ns->budget = budget;
+    char* block = alloc_pages(NODE_SIZE * ns->capacity, &ns->mapped, &ns->mem, budget);
+    if (block == NULL) {
+        free(ns);
+        return NULL;
+    }
+    place_columns(ns, block, ns->capacity);
+    return ns;
+}
+
+void place_columns(node_store* ns, char* block, int capacity) {
+    // widest column first, so every column is aligned to its element
+    ns->boards = (uint64_t*) block;
+    ns->parents = (int*) (ns->boards + capacity);
+    ns->g = (uint8_t*) (ns->parents + capacity);
+    ns->h = ns->g + capacity;
+    ns->moves = ns->h + capacity;
+}
+
+int grow_nodes(node_store* ns) {
+    // the columns move to a block twice the size, nodes are indices so they stay valid
+    size_t mapped;
+    int capacity = ns->capacity * 2;
+    char* block = alloc_pages(NODE_SIZE * capacity, &mapped, &ns->mem, ns->budget);
+    if (block == NULL) {
+        return 1;
+    }
+    node_store old = *ns;
+    place_columns(ns, block, capacity);
+    memcpy(ns->boards, old.boards, sizeof(uint64_t) * old.size);
+    memcpy(ns->parents, old.parents, sizeof(int) * old.size);
+    memcpy(ns->g, old.g, old.size);
+    memcpy(ns->h, old.h, old.size);
+    memcpy(ns->moves, old.moves, old.size);
+    free_pages(old.boards, NODE_SIZE * old.capacity, old.mapped, &ns->mem, ns->budget);
+    ns->capacity = capacity;
+    ns->mapped = mapped;
+    return 0;
+}
+
+int new_node(node_store* ns, const board brd, int parent, int g, int h, move mv) {
+    // nodes are owned by the store so they are accounted and released together, returns -1 if out of memory
+    if (ns->size >= ns->capacity && grow_nodes(ns) != 0) {
+        return -1;
+    }
+    int node = ns->size++;
+    ns->boards[node] = pack_board(brd);
+    ns->parents[node] = parent;
+    ns->g[node] = (uint8_t) g;
+    ns->h[node] = (uint8_t) h;
+    ns->moves[node] = (uint8_t) mv;
+    return node;
+}
+
+void clear_nodes(node_store* ns) {
+    // the block is kept for the next solve, so clearing doesn't touch the allocator
+    ns->size = 0;
+}
+
+void free_nodes(node_store* ns) {
+    free_pages(ns->boards, NODE_SIZE * ns->capacity, ns->mapped, &ns->mem, ns->budget);
+    free(ns);
+}
+
+uint64_t pack_board(const board brd) {
+    uint64_t packed = 0;
+    for (int i = 0; i < SIZE; i++) {
+        packed |= (uint64_t) brd[i] << (TILE_BITS * i);
+    }
+    return packed;
+}
+
+void unpack_board(uint64_t packed, board brd) {
+    for (int i = 0; i < SIZE; i++) {
+        brd[i] = (tile) ((packed >> (TILE_BITS * i)) & ((1 << TILE_BITS) - 1));
+    }
+}
+
+// HASH TABLE IMPLEMENTATION
+
+hash_table* new_ht(mem_budget* budget) {
+    hash_table* ht = malloc(sizeof(hash_table));
+    if (ht == NULL) {
+        return NULL;
+    }
+    ht->capacity = next_prime(10);
+    ht->size = 0;
+    ht->generation = 1;
+    ht->mem = (mem_usage) {0};
+    ht->budget = budget;
+    ht->table = alloc_pages(sizeof(ht_slot) * ht->capacity, &ht->mapped, &ht->mem, budget);
+    if (ht->table == NULL) {
+        free(ht);
+        return NULL;
+    }
+    // generation 0 is never current, so zeroed slots start out empty
+    memset(ht->table, 0, sizeof(ht_slot) * ht->capacity);
+    return ht;
+}
+
+int hash_board(const board board) {
+    // hash function takes each symbol in the puzzle from start to end as a digit
+    int hash = 0;
+    for (int i = 0; i < SIZE; i++) {
+        hash += board[i] * (int) pow(10, i);
+    }
+    return hash;
+}
+
+int probe(hash_table* ht, int h, int i) {
+    return (h + i) % ht->capacity; // linear probe
+}
+
+int rehash(hash_table* ht) {
+    // keep references to old structures before creating new structures
+    int old_capacity = ht->capacity;
+    ht_slot* old_table = ht->table;
+    // allocate a new hash table and rehash all old elements into it
+    int new_capacity = next_prime(ht->capacity * 2);
+    size_t old_mapped = ht->mapped;
+    size_t new_mapped;
+    ht_slot* new_table = alloc_pages(sizeof(ht_slot) * new_capacity, &new_mapped, &ht->mem, ht->budget);
+    // check for allocation errors, the old table stays valid on failure
+    if (new_table == NULL) {
+        return 1;
+    }
+    memset(new_table, 0, sizeof(ht_slot) * new_capacity);
+    ht->capacity = new_capacity;
+    ht->table = new_table;
+    ht->mapped = new_mapped;
+    // add all live keys from the old to the new table, stale generations are dropped
+    for (int i = 0; i < old_capacity; i++) {
+        if (old_table[i].generation == ht->generation) {
+            probe_ht(ht, old_table[i].key);
+        }
+    }
+    // free the old hash table
+    free_pages(old_table, sizeof(ht_slot) * old_capacity, old_mapped, &ht->mem, ht->budget);
+    return 0;
+}
+
+int insert_into_ht(hash_table* ht, int key) {
+    // rehash when load factor exceeds threshold
+    if ((float) ht->size / (float) ht->capacity > LF_THRESHOLD && rehash(ht) != 0) {
+        return 1;
+    }
+    probe_ht(ht, key);
+    ht->size++;
+    return 0;
+}
+
+void probe_ht(hash_table* ht, int key) {
+    // probe until we find a slot to insert
+    for (int i = 0;; i++) {
+        int p = probe(ht, key, i);
+        if (ht->table[p].generation != ht->generation) {
+            ht->table[p].key = key;
+            ht->table[p].generation = ht->generation;
+            break;
+        }
+    }
+}
+
+void prefetch_ht(hash_table* ht, int key) {
+    // the first probe is the only likely miss, linear probing continues on the same or the next line
+    __builtin_prefetch(&ht->table[probe(ht, key, 0)]);
+}
+
+int ht_has_key(hash_table* ht, int key) {
+    // probe until we find a match or the first empty slot
+    for (int i = 0;; i++) {
+        int p = probe(ht, key, i);
+        if (ht->table[p].generation != ht->generation) {
+            // probed until empty slot so board isn't in table
+            return 0;
+        } else if (ht->table[p].key == key) {
+            // hash values match so board is in table
+            return 1;
+        }
+    }
+}
+
+int is_prime(int n) {
+    // iterate from 2 to sqrt(n)
+    for (int i = 2; i <= sqrt(n); i++) {
+        // if n is divisible by any number between 2 and n/2, it is not prime
+        if (n % i == 0) {
+            return 0;
+        }
+    }
+    if (n <= 1)
+        return 0;
+    return 1;
+}
+
+int next_prime(int n) {
+    for (int i = n;; i++) {
+        if (is_prime(i)) {
+            return i;
+        }
+    }
+}
+
+void clear_ht(hash_table* ht) {
+    // slots from older generations read as empty, so clearing is O(1) whatever the capacity
+    ht->size = 0;
+    ht->generation++;
+    if (ht->generation == 0) {
+        // the counter wrapped, so wipe the stamps once and skip the never current generation 0
+        memset(ht->table, 0, sizeof(ht_slot) * ht->capacity);
+        ht->generation = 1;
+    }
+}
+
+void free_ht(hash_table* ht) {
+    free_pages(ht->table, sizeof(ht_slot) * ht->capacity, ht->mapped, &ht->mem, ht->budget);
+    free(ht);
+}
+
+// PQ IMPLEMENTATION
+
+priority_q* new_pq(mem_budget* budget) {
+    priority_q* pq = malloc(sizeof(priority_q));
+    if (pq == NULL) {
+        return NULL;
+    }
+    pq->capacity = 10;
+    pq->size = 0;
+    pq->mem = (mem_usage) {0};
+    pq->budget = budget;
+    pq->min_heap = alloc_pages(sizeof(pq_entry) * pq->capacity, &pq->mapped, &pq->mem, budget);
+    if (pq->min_heap == NULL) {
+        free(pq);
+        return NULL;
+    }
+    return pq;
+}
+
+int ensure_capacity(priority_q* pq) {
+    // ensure min_heap's capacity is large enough
+    if (pq->size >= pq->capacity) {
+        size_t old_size = sizeof(pq_entry) * pq->capacity;
+        size_t mapped;
+        pq_entry* min_heap = alloc_pages(old_size * 2, &mapped, &pq->mem, pq->budget);
+        // check for allocation errors, the old heap stays valid on failure
+        if (min_heap == NULL) {
+            return 1;
+        }
+        memcpy(min_heap, pq->min_heap, sizeof(pq_entry) * pq->size);
+        free_pages(pq->min_heap, old_size, pq->mapped, &pq->mem, pq->budget);
+        pq->min_heap = min_heap;
+        pq->mapped = mapped;
+        pq->capacity = pq->capacity * 2;
+    }
+    return 0;
+}
+
+int push_pq(priority_q* pq, int node, int f) {
+    if (ensure_capacity(pq) != 0) {
+        return 1;
+    }
+    // add element to end of min_heap
+    pq->min_heap[pq->size] = (pq_entry) {f, node};
+    // sift the min_heap up
+    int pos = pq->size;
+    int parent = (pos - 1) / CHILD_CNT;
+    // sift up until parent score is larger
+    while (parent >= 0) {
+        if (pq->min_heap[pos].f < pq->min_heap[parent].f) {
+            // swap parent with child
+            pq_entry temp = pq->min_heap[pos];
+            pq->min_heap[pos] = pq->min_heap[parent];
+            pq->min_heap[parent] = temp;
+            // climb up the tree
+            pos = parent;
+            parent = (pos - 1) / CHILD_CNT;
+        } else {
+            parent = -1;
+        }
+    }
+    pq->size++;
+    return 0;
+}
+
+int pop_pq(priority_q* pq) {
+    // check for empty min_heap
+    if (pq->size == 0) {
+        return -1;
+    }
+    // extract top element and move bottom to top
+    int top = pq->min_heap[0].node;
+    pq->min_heap[0] = pq->min_heap[pq->size - 1];
+    // sift top element down
+    int pos = 0;
+    for (;;) {
+        // get the smallest child
+        int first_child = CHILD_CNT * pos + 1;
+        int child = first_child;
+        if (child >= pq->size) {
+            break;
+        }
+        // iterate from leftmost to rightmost child to find the smallest at level
+        for (int i = 1; i < CHILD_CNT; i++) {
+            int new_child = first_child + i;
+            if (new_child >= pq->size) {
+                break;
+            }
+            if(pq->min_heap[new_child].f < pq->min_heap[child].f) {
+                child = new_child;
+            }
+        }
+        // swap child with parent if child is smaller
+        if (pq->min_heap[pos].f > pq->min_heap[child].f) {
+            // swap parent with child
+            pq_entry temp = pq->min_heap[pos];
+            pq->min_heap[pos] = pq->min_heap[child];
+            pq->min_heap[child] = temp;
+            // climb down tree
+            pos = child;
+        } else {
+            break;
+        }
+    }
+    pq->size--;
+    return top;
+}
+
+void clear_pq(priority_q* pq) {
+    pq->size = 0;
+}
+
+void free_pq(priority_q* pq) {
+    free_pages(pq->min_heap, sizeof(pq_entry) * pq->capacity, pq->mapped, &pq->mem, pq->budget);
+    free(pq);
+}
+
+// SOLVER CONTEXT IMPLEMENTATION
+
+const char* puzzle_version() {
+    return VERSION;
+}
+
+solver_ctx* new_solver(size_t mem_limit) {
+    solver_ctx* ctx = malloc(sizeof(solver_ctx));
+    if (ctx == NULL) {
+        return NULL;
+    }
+    ctx->budget = (mem_budget) {{0}, mem_limit, 0, 0, PAGES_DEFAULT, -1, 0};
+    ctx->counters[0] = -1;
+    ctx->counters[1] = -1;
+    ctx->trace = NULL;
+    ctx->report = NULL;
+    ctx->timeout_ms = 0;
+    ctx->cancel = NULL;
+    ctx->heuristic = MANHATTAN;
+    ctx->isa = detect_isa();
+    ctx->algorithm = ASTAR;
+    ctx->pruning = PRUNE_FSM;
+    ctx->pruner = NULL;
+    ctx->table = NULL;
+    ctx->h_dist_goal = 0;
+    ctx->h_dist_heuristic = -1;
+    for (int i = 0; i < SIZE; i++) {
+        ctx->tree_pruning[i] = -1;
+        ctx->graph_counted[i] = 0;
+    }
+    ctx->active = ASTAR;
+    ctx->switch_expanded = 0;
+    ctx->status = INVALID_BOARD;
+    ctx->stats = (solve_stats) {0};
+    ctx->nodes = new_nodes(&ctx->budget);
+    ctx->open_set = new_pq(&ctx->budget);
+    ctx->closed_set = new_ht(&ctx->budget);
+    if (ctx->nodes == NULL || ctx->open_set == NULL || ctx->closed_set == NULL) {
+        free_solver(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+void free_solver(solver_ctx* ctx) {
+    close_counters(ctx->counters);
+    if (ctx->nodes != NULL) {
+        free_nodes(ctx->nodes);
+    }
+    if (ctx->open_set != NULL) {
+        free_pq(ctx->open_set);
+    }
+    if (ctx->closed_set != NULL) {
+        free_ht(ctx->closed_set);
+    }
+    if (ctx->pruner != NULL) {
+        free_fsm(ctx->pruner, &ctx->budget);
+    }
+    free(ctx);
+}
+
+void set_solver_trace(solver_ctx* ctx, trace_buffer* trace) {
+    ctx->trace = trace;
+}
+
+void set_solver_report(solver_ctx* ctx, solve_report* report) {
+    ctx->report = report;
+}
+
+void set_solver_heuristic(solver_ctx* ctx, solve_heuristic heuristic) {
+    ctx->heuristic = heuristic;
+}
+
+void set_solver_algorithm(solver_ctx* ctx, solve_algorithm algorithm) {
+    ctx->algorithm = algorithm;
+}
+
+void set_solver_pruning(solver_ctx* ctx, solve_pruning pruning) {
+    ctx->pruning = pruning;
+}
+
+void set_solver_table(solver_ctx* ctx, const uint8_t* distances) {
+    ctx->table = distances;
+}
+
+const char* algorithm_name(solve_algorithm algorithm) {
+    return algorithm >= ASTAR && algorithm < ALGORITHM_CNT ? ALGORITHM_STRINGS[algorithm] : "unknown";
+}
+
+int parse_algorithm(const char* name, solve_algorithm* algorithm) {
+    for (int i = 0; i < ALGORITHM_CNT; i++) {
+        if (strcmp(name, ALGORITHM_STRINGS[i]) == 0) {
+            *algorithm = (solve_algorithm) i;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int parse_heuristic(const char* name, solve_heuristic* heuristic) {
+    for (int i = 0; i < HEURISTIC_CNT; i++) {
+        if (strcmp(name, HEURISTIC_STRINGS[i]) == 0) {
+            *heuristic = (solve_heuristic) i;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int parse_pruning(const char* name, solve_pruning* pruning) {
+    for (int i = 0; i < PRUNING_CNT; i++) {
+        if (strcmp(name, PRUNING_STRINGS[i]) == 0) {
+            *pruning = (solve_pruning) i;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int set_solver_isa(solver_ctx* ctx, solve_isa isa) {
+    if (!isa_supported(isa)) {
+        return 1;
+    }
+    ctx->isa = isa;
+    return 0;
+}
+
+solve_isa solver_isa(const solver_ctx* ctx) {
+    return ctx->isa;
+}
+
+int set_solver_huge_pages(solver_ctx* ctx, int enabled) {
+    ctx->budget.huge_pages = enabled;
+    return rebuild_structures(ctx);
+}
+
+int set_solver_numa_node(solver_ctx* ctx, int node) {
+    if (node < -1 || node >= numa_node_cnt()) {
+        return 1;
+    }
+    ctx->budget.numa_node = node;
+    ctx->budget.numa_failed = 0;
+    return rebuild_structures(ctx);
+}
+
+int rebuild_structures(solver_ctx* ctx) {
+    // how a structure is backed is decided when it is allocated, so all three are rebuilt while they are empty
+    node_store* nodes = new_nodes(&ctx->budget);
+    priority_q* open_set = new_pq(&ctx->budget);
+    hash_table* closed_set = new_ht(&ctx->budget);
+    if (nodes == NULL || open_set == NULL || closed_set == NULL) {
+        if (nodes != NULL) {
+            free_nodes(nodes);
+        }
+        if (open_set != NULL) {
+            free_pq(open_set);
+        }
+        if (closed_set != NULL) {
+            free_ht(closed_set);
+        }
+        return 1;
+    }
+    free_nodes(ctx->nodes);
+    free_pq(ctx->open_set);
+    free_ht(ctx->closed_set);
+    ctx->nodes = nodes;
+    ctx->open_set = open_set;
+    ctx->closed_set = closed_set;
+    return 0;
+}
+
+int set_solver_counters(solver_ctx* ctx, int enabled) {
+    // the counters follow the thread that opened them, which is the thread that solves with this context
+    close_counters(ctx->counters);
+    return enabled && open_counters(ctx->counters) != 0;
+}
+
+void set_solver_timeout(solver_ctx* ctx, long timeout_ms) {
+    ctx->timeout_ms = timeout_ms;
+}
+
+void set_solver_cancel(solver_ctx* ctx, cancel_token* cancel) {
+    ctx->cancel = cancel;
+}
+
+// CANCELLATION IMPLEMENTATION
+
+cancel_token* new_cancel_token() {
+    cancel_token* token = malloc(sizeof(cancel_token));
+    if (token == NULL) {
+        return NULL;
+    }
+    atomic_init(&token->cancelled, 0);
+    return token;
+}
+
+void cancel_solve(cancel_token* token) {
+    // a lock free store, so this is safe from other threads and signal handlers
+    atomic_store_explicit(&token->cancelled, 1, memory_order_relaxed);
+}
+
+void free_cancel_token(cancel_token* token) {
+    free(token);
+}
+
+solve_status poll_cancel(solver_ctx* ctx, double deadline) {
+    if (ctx->cancel != NULL && atomic_load_explicit(&ctx->cancel->cancelled, memory_order_relaxed)) {
+        return CANCELLED;
+    }
+    if (deadline > 0 && now_ns() >= deadline) {
+        return TIMED_OUT;
+    }
+    return IN_PROGRESS;
+}
+
+// PUZZLE SOLVER IMPLEMENTATION
+
+int find_zero(const board brd) {
+    for (int i = 0; i < SIZE; i++)
+        if (brd[i] == 0)
+            return i;
+    return -1;
+}
+
+int move_board(const board brd_in, board brd_out, int row_offset, int col_offset) {
+    // copy input to output (overrides output board)
+    memcpy(brd_out, brd_in, sizeof(board));
+    // find the location of the zero on the board
+    int zero_loc = find_zero(brd_in);
+    if (zero_loc < 0) {
+        return 1;
+    }
+    int zero_row = zero_loc / ROWS;
+    int zero_col = zero_loc % ROWS;
+    // find the location of the tile to be swapped
+    int swap_row = zero_row + row_offset;
+    int swap_col = zero_col + col_offset;
+    int swap_loc = swap_col + ROWS * swap_row;
+    // check if puzzle is out of bounds
+    if (swap_row < 0 || swap_row >= ROWS || swap_col < 0 || swap_col >= ROWS) {
+        return 1;
+    }
+    // swap location of 0 with new location
+    tile temp = brd_out[zero_loc];
+    brd_out[zero_loc] = brd_out[swap_loc];
+    brd_out[swap_loc] = temp;
+    return 0;
+}
+
+void index_goal(const board goal, int* goal_index) {
+    for (int i = 0; i < SIZE; i++) {
+        goal_index[(int) goal[i]] = i;
+    }
+}
+
+int heuristic(const board brd, const int* goal_index) {
+    int h = 0;
+    for (int i = 0; i < SIZE; i++) {
+        // manhattan distance
+        int row1 = i / ROWS;
+        int col1 = i % ROWS;
+        // the blank doesn't count
+        if (brd[i] == 0) {
+            continue;
+        }
+        int row2 = goal_index[(int) brd[i]] / ROWS;
+        int col2 = goal_index[(int) brd[i]] % ROWS;
+        h += abs(row2 - row1) + abs(col2 - col1);
+    }
+    return h;
+}
+
+int misplaced_tiles(const board brd, const int* goal_index) {
+    // hamming distance, every tile other than the blank that isn't home needs at least one move
+    int h = 0;
+    for (int i = 0; i < SIZE; i++) {
+        if (brd[i] != 0 && goal_index[(int) brd[i]] != i) {
+            h++;
+        }
+    }
+    return h;
+}
+
+int is_valid_board(const board brd) {
+    // every tile from 0 to 8 must appear exactly once
+    int seen[SIZE] = {0};
+    for (int i = 0; i < SIZE; i++) {
+        if (brd[i] < 0 || brd[i] >= SIZE || seen[(int) brd[i]]) {
+            return 0;
+        }
+        seen[(int) brd[i]] = 1;
+    }
+    return 1;
+}
+
+int is_solvable(const board initial_brd, const board goal_brd) {
+    // with an odd width every move keeps the parity of the inversions among the tiles, so both boards must share it
+    int parity = 0;
+    for (int i = 0; i < SIZE; i++) {
+        for (int j = i + 1; j < SIZE; j++) {
+            parity ^= initial_brd[i] != 0 && initial_brd[j] != 0 && initial_brd[j] < initial_brd[i];
+            parity ^= goal_brd[i] != 0 && goal_brd[j] != 0 && goal_brd[j] < goal_brd[i];
+        }
+    }
+    return parity == 0;
+}
+
+int estimate_moves(const board brd, const board goal, solve_heuristic h) {
+    if (!is_valid_board(brd) || !is_valid_board(goal) || !is_solvable(brd, goal)) {
+        return -1;
+    }
+    int goal_index[SIZE];
+    index_goal(goal, goal_index);
+    return h == MISPLACED ? misplaced_tiles(brd, goal_index) : heuristic(brd, goal_index);
+}
+
+solve_status start_solve(solver_ctx* ctx, const board initial_brd, const board goal_brd) {
+    ctx->stats = (solve_stats) {0};
+    ctx->stats.numa_node = -1;
+    ctx->stats.node_loads = -1;
+    ctx->stats.remote_loads = -1;
+    ctx->stats.predicted = -1;
+    ctx->status = INVALID_BOARD;
+    if (!is_valid_board(initial_brd) || !is_valid_board(goal_brd)) {
+        return ctx->status;
+    }
+    ctx->goal_hash = hash_board(goal_brd);
+    index_goal(goal_brd, ctx->goal_index);
+    index_lanes(ctx->goal_index, &ctx->lanes);
+    memcpy(ctx->initial, initial_brd, sizeof(board));
+    memcpy(ctx->goal, goal_brd, sizeof(board));
+
+    trace_buffer* trace = ctx->trace;
+    trace_begin(trace, "setup");
+
+    // the structures keep their capacity from earlier solves, so peaks are measured from here
+    reset_peak(&ctx->budget.total);
+    reset_peak(&ctx->nodes->mem);
+    reset_peak(&ctx->open_set->mem);
+    reset_peak(&ctx->closed_set->mem);
+    if (ctx->pruner != NULL) {
+        reset_peak(&ctx->pruner->mem);
+    }
+    ctx->allocations = ctx->budget.allocations;
+    ctx->deadline = ctx->timeout_ms > 0 ? now_ns() + (double) ctx->timeout_ms * 1e6 : 0;
+    ctx->f_layer = -1;
+
+    ctx->switch_expanded = 0;
+    ctx->active = ctx->algorithm == AUTO_SELECT || ctx->algorithm == TABLE_LOOKUP
+        ? select_algorithm(ctx)
+        : ctx->algorithm;
+    ctx->stats.algorithm = ctx->active;
+    if (ctx->active == TABLE_LOOKUP) {
+        ctx->status = walk_table(ctx);
+    } else if (ctx->active == IDASTAR) {
+        ctx->status = start_ida(ctx);
+    } else {
+        ctx->status = start_astar(ctx);
+    }
+    trace_end(trace, "setup");
+    start_counters(ctx->counters);
+    if (ctx->status != IN_PROGRESS) {
+        finish_solve(ctx);
+    }
+    return ctx->status;
+}
+
+solve_status start_astar(solver_ctx* ctx) {
+    // the open set starts with the root, the structures were cleared by the last solve
+    int h = estimate(ctx, ctx->initial);
+    int root = new_node(ctx->nodes, ctx->initial, -1, 0, h, NONE);
+    if (root < 0) {
+        return OUT_OF_MEMORY;
+    }
+    // a search moved over from IDA* keeps the best h it already found
+    if (ctx->stats.expanded == 0) {
+        ctx->stats.best_h = h;
+    }
+    return push_pq(ctx->open_set, root, h) == 0 ? IN_PROGRESS : OUT_OF_MEMORY;
+}
+
+// the default policies, a heap of node indices and a generation stamped closed set keyed by hash_board
+#define DEFAULT_STATE_KEY(brd) hash_board(brd)
+#define DEFAULT_OPEN_PUSH(ctx, node, f) push_pq((ctx)->open_set, node, f)
+#define DEFAULT_OPEN_POP(ctx) pop_pq((ctx)->open_set)
+#define DEFAULT_OPEN_SIZE(ctx) ((ctx)->open_set->size)
+#define DEFAULT_CLOSED_INSERT(ctx, key) insert_into_ht((ctx)->closed_set, key)
+#define DEFAULT_CLOSED_HAS(ctx, key) ht_has_key((ctx)->closed_set, key)
+#define DEFAULT_CLOSED_PREFETCH(ctx, key) prefetch_ht((ctx)->closed_set, key)
+#define DEFAULT_CLOSED_SIZE(ctx) ((ctx)->closed_set->size)
+
+// the scalar heuristics index the goal directly, the vector kernels look up its lanes
+#define MANHATTAN_HEURISTIC(ctx, brd) heuristic(brd, (ctx)->goal_index)
+#define MISPLACED_HEURISTIC(ctx, brd) misplaced_tiles(brd, (ctx)->goal_index)
+#define SSE42_HEURISTIC(ctx, brd) manhattan_sse42(brd, &(ctx)->lanes)
+#define AVX2_HEURISTIC(ctx, brd) manhattan_avx2(brd, &(ctx)->lanes)
+#define AVX512_HEURISTIC(ctx, brd) manhattan_avx512(brd, &(ctx)->lanes)
+
+#define ENGINE_STEP step_manhattan
+#define ENGINE_STATE_KEY DEFAULT_STATE_KEY
+#define ENGINE_HEURISTIC MANHATTAN_HEURISTIC
+#define ENGINE_OPEN_PUSH DEFAULT_OPEN_PUSH
+#define ENGINE_OPEN_POP DEFAULT_OPEN_POP
+#define ENGINE_OPEN_SIZE DEFAULT_OPEN_SIZE
+#define ENGINE_CLOSED_INSERT DEFAULT_CLOSED_INSERT
+#define ENGINE_CLOSED_HAS DEFAULT_CLOSED_HAS
+#define ENGINE_CLOSED_PREFETCH DEFAULT_CLOSED_PREFETCH
+#define ENGINE_CLOSED_SIZE DEFAULT_CLOSED_SIZE
+#include "astar_engine.h"
+
+#define ENGINE_STEP step_misplaced
+#define ENGINE_STATE_KEY DEFAULT_STATE_KEY
+#define ENGINE_HEURISTIC MISPLACED_HEURISTIC
+#define ENGINE_OPEN_PUSH DEFAULT_OPEN_PUSH
+#define ENGINE_OPEN_POP DEFAULT_OPEN_POP
+#define ENGINE_OPEN_SIZE DEFAULT_OPEN_SIZE
+#define ENGINE_CLOSED_INSERT DEFAULT_CLOSED_INSERT
+#define ENGINE_CLOSED_HAS DEFAULT_CLOSED_HAS
+#define ENGINE_CLOSED_PREFETCH DEFAULT_CLOSED_PREFETCH
+#define ENGINE_CLOSED_SIZE DEFAULT_CLOSED_SIZE
+#include "astar_engine.h"
+
+#ifdef HAVE_X86_KERNELS
+
+#define ENGINE_STEP step_manhattan_sse42
+#define ENGINE_STATE_KEY DEFAULT_STATE_KEY
+#define ENGINE_HEURISTIC SSE42_HEURISTIC
+#define ENGINE_OPEN_PUSH DEFAULT_OPEN_PUSH
+#define ENGINE_OPEN_POP DEFAULT_OPEN_POP
+#define ENGINE_OPEN_SIZE DEFAULT_OPEN_SIZE
+#define ENGINE_CLOSED_INSERT DEFAULT_CLOSED_INSERT
+#define ENGINE_CLOSED_HAS DEFAULT_CLOSED_HAS
+#define ENGINE_CLOSED_PREFETCH DEFAULT_CLOSED_PREFETCH
+#define ENGINE_CLOSED_SIZE DEFAULT_CLOSED_SIZE
+#include "astar_engine.h"
+
+#define ENGINE_STEP step_manhattan_avx2
+#define ENGINE_STATE_KEY DEFAULT_STATE_KEY
+#define ENGINE_HEURISTIC AVX2_HEURISTIC
+#define ENGINE_OPEN_PUSH DEFAULT_OPEN_PUSH
+#define ENGINE_OPEN_POP DEFAULT_OPEN_POP
+#define ENGINE_OPEN_SIZE DEFAULT_OPEN_SIZE
+#define ENGINE_CLOSED_INSERT DEFAULT_CLOSED_INSERT
+#define ENGINE_CLOSED_HAS DEFAULT_CLOSED_HAS
+#define ENGINE_CLOSED_PREFETCH DEFAULT_CLOSED_PREFETCH
+#define ENGINE_CLOSED_SIZE DEFAULT_CLOSED_SIZE
+#include "astar_engine.h"
+
+#define ENGINE_STEP step_manhattan_avx512
+#define ENGINE_STATE_KEY DEFAULT_STATE_KEY
+#define ENGINE_HEURISTIC AVX512_HEURISTIC
+#define ENGINE_OPEN_PUSH DEFAULT_OPEN_PUSH
+#define ENGINE_OPEN_POP DEFAULT_OPEN_POP
+#define ENGINE_OPEN_SIZE DEFAULT_OPEN_SIZE
+#define ENGINE_CLOSED_INSERT DEFAULT_CLOSED_INSERT
+#define ENGINE_CLOSED_HAS DEFAULT_CLOSED_HAS
+#define ENGINE_CLOSED_PREFETCH DEFAULT_CLOSED_PREFETCH
+#define ENGINE_CLOSED_SIZE DEFAULT_CLOSED_SIZE
+#include "astar_engine.h"
+
+#endif
+
+solve_status step_solve(solver_ctx* ctx, long max_expansions) {
+    // dispatch once per slice, the loops themselves have no indirection
+    if (ctx->active == IDASTAR) {
+        long expanded = ctx->stats.expanded;
+        solve_status status = step_ida(ctx, max_expansions);
+        if (status != IN_PROGRESS || ctx->active == IDASTAR) {
+            return status;
+        }
+        // AUTO_SELECT moved the search to A*, which gets the rest of the slice
+        max_expansions -= ctx->stats.expanded - expanded;
+    }
+    if (ctx->heuristic == MISPLACED) {
+        return step_misplaced(ctx, max_expansions);
+    }
+    switch (ctx->isa) {
+#ifdef HAVE_X86_KERNELS
+        case ISA_AVX512:
+            return step_manhattan_avx512(ctx, max_expansions);
+        case ISA_AVX2:
+            return step_manhattan_avx2(ctx, max_expansions);
+        case ISA_SSE42:
+            return step_manhattan_sse42(ctx, max_expansions);
+#endif
+        default:
+            return step_manhattan(ctx, max_expansions);
+    }
+}
+
+int estimate(const solver_ctx* ctx, const board brd) {
+    if (ctx->heuristic == MISPLACED) {
+        return misplaced_tiles(brd, ctx->goal_index);
+    }
+    return ctx->isa == ISA_SCALAR ? heuristic(brd, ctx->goal_index) : kernel_for(ctx->isa)(brd, &ctx->lanes);
+}
+
+void finish_solve(solver_ctx* ctx) {
+    trace_begin(ctx->trace, "cleanup");
+    // record usage before the structures are cleared for the next solve
+    ctx->stats.total = ctx->budget.total;
+    ctx->stats.puzzles = ctx->nodes->mem;
+    ctx->stats.open_set = ctx->open_set->mem;
+    ctx->stats.closed_set = ctx->closed_set->mem;
+    ctx->stats.pruner = ctx->pruner != NULL ? ctx->pruner->mem : (mem_usage) {0};
+    ctx->stats.allocations = ctx->budget.allocations - ctx->allocations;
+    ctx->stats.pages = ctx->budget.pages;
+    ctx->stats.numa_node = ctx->budget.numa_failed ? -1 : ctx->budget.numa_node;
+    read_counters(ctx->counters, &ctx->stats.node_loads, &ctx->stats.remote_loads);
+    ctx->stats.algorithm = ctx->active;
+    if (ctx->algorithm == AUTO_SELECT || ctx->algorithm == TABLE_LOOKUP) {
+        record_prediction(ctx);
+    }
+    clear_nodes(ctx->nodes);
+    clear_pq(ctx->open_set);
+    clear_ht(ctx->closed_set);
+    trace_end(ctx->trace, "cleanup");
+}
+
+solve_status solve_result(const solver_ctx* ctx, move* out_moves, solve_stats* stats) {
+    // stats show the progress so far while a search is still in progress
+    *stats = ctx->stats;
+    if (ctx->status == SOLVED && out_moves != NULL) {
+        memcpy(out_moves, ctx->path, sizeof(move) * ctx->stats.steps);
+    }
+    return ctx->status;
+}
+
+int copy_path(const solver_ctx* ctx, move* out_moves, int capacity) {
+    if (ctx->status != SOLVED || ctx->stats.steps > capacity) {
+        return -1;
+    }
+    memcpy(out_moves, ctx->path, sizeof(move) * ctx->stats.steps);
+    return ctx->stats.steps;
+}
+
+int stream_path(const solver_ctx* ctx, move_callback callback, void* user) {
+    if (ctx->status != SOLVED) {
+        return 1;
+    }
+    // replay the path on a board on the stack so the callback sees every intermediate board
+    board brd;
+    memcpy(brd, ctx->initial, sizeof(board));
+    for (int i = 0; i < ctx->stats.steps; i++) {
+        apply_move(brd, ctx->path[i]);
+        if (callback(ctx->path[i], brd, user) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char* move_name(move mv) {
+    return mv >= NONE && mv <= RIGHT ? MOVE_STRINGS[mv] : NULL;
+}
+
+const char* status_name(solve_status status) {
+    return status >= SOLVED && status <= IN_PROGRESS ? STATUS_STRINGS[status] : "unknown";
+}
+
+solve_status solve(solver_ctx* ctx, const board initial_brd, const board goal_brd, move* out_moves,
+                   solve_stats* stats) {
+    trace_begin(ctx->trace, "solve");
+    if (start_solve(ctx, initial_brd, goal_brd) == IN_PROGRESS) {
+        step_solve(ctx, LONG_MAX);
+    }
+    trace_end(ctx->trace, "solve");
+    return solve_result(ctx, out_moves, stats);
+}
+
+void reconstruct_path(const node_store* ns, int leaf, int steps, move* out_moves) {
+    // walking up the parents fills the path from the back, only the parent and move columns are read
+    for (int node = leaf; ns->parents[node] >= 0; node = ns->parents[node]) {
+        out_moves[--steps] = (move) ns->moves[node];
+    }
+}
+
+int apply_move(board brd, move mv) {
+    // moves a board in place, returns 1 if the move is illegal
+    for (int i = 0; i < NEIGHBOR_CNT; i++) {
+        if ((move) NEIGHBOR_MOVES[i] == mv) {
+            board moved;
+            if (move_board(brd, moved, NEIGHBOR_OFFSETS[i][0], NEIGHBOR_OFFSETS[i][1]) != 0) {
+                return 1;
+            }
+            memcpy(brd, moved, sizeof(board));
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int parse_board(board brd, FILE* input_file) {
+    int count = 0;
+    while (count < SIZE) {
+        char c = (char) fgetc(input_file);
+        if (c == EOF)
+            break;
+        if(isdigit(c)) {
+            int symbol = c - '0';
+            brd[count] = (char) symbol;
+            count++;
+        }
+    }
+    // returns 1 if the input doesn't hold a full board
+    return count < SIZE || !is_valid_board(brd);
+}
+
+// DISTANCE TABLE IMPLEMENTATION
+
+int rank_board(const board brd) {
+    // lehmer code of the permutation, a dense index in [0, 9!)
+    int rank = 0;
+    for (int i = 0; i < SIZE; i++) {
+        int smaller = 0;
+        for (int j = i + 1; j < SIZE; j++) {
+            if (brd[j] < brd[i]) {
+                smaller++;
+            }
+        }
+        rank = rank * (SIZE - i) + smaller;
+    }
+    return rank;
+}
+
+void unrank_board(int rank, board brd) {
+    // decode the lehmer digits from least to most significant, then pick tiles from the unused set
+    int digits[SIZE];
+    for (int i = SIZE - 1; i >= 0; i--) {
+        digits[i] = rank % (SIZE - i);
+        rank /= SIZE - i;
+    }
+    int used[SIZE] = {0};
+    for (int i = 0; i < SIZE; i++) {
+        int t = 0;
+        for (int skip = digits[i];; t++) {
+            if (!used[t] && skip-- == 0) {
+                break;
+            }
+        }
+        used[t] = 1;
+        brd[i] = (tile) t;
+    }
+}
+
+uint8_t* new_distance_table(const board goal) {
+    // breadth first search backwards from the goal gives the true distance of every reachable board
+    uint8_t* distances = malloc(PERM_CNT);
+    int* queue = malloc(sizeof(int) * PERM_CNT / 2);
+    if (distances == NULL || queue == NULL) {
+        free(distances);
+        free(queue);
+        return NULL;
+    }
+    memset(distances, UNREACHABLE, PERM_CNT);
+    int head = 0, tail = 0;
+    int goal_rank = rank_board(goal);
+    distances[goal_rank] = 0;
+    queue[tail++] = goal_rank;
+    while (head < tail) {
+        int rank = queue[head++];
+        board brd;
+        unrank_board(rank, brd);
+        for (int i = 0; i < NEIGHBOR_CNT; i++) {
+            board neighbor_board;
+            if (move_board(brd, neighbor_board, NEIGHBOR_OFFSETS[i][0], NEIGHBOR_OFFSETS[i][1]) == 0) {
+                int neighbor_rank = rank_board(neighbor_board);
+                if (distances[neighbor_rank] == UNREACHABLE) {
+                    distances[neighbor_rank] = (uint8_t) (distances[rank] + 1);
+                    queue[tail++] = neighbor_rank;
+                }
+            }
+        }
+    }
+    free(queue);
+    return distances;
+}
+
+uint8_t* load_distance_table(FILE* input_file) {
+    uint8_t* distances = malloc(PERM_CNT);
+    if (distances == NULL) {
+        return NULL;
+    }
+    if (fread(distances, 1, PERM_CNT, input_file) != PERM_CNT) {
+        free(distances);
+        return NULL;
+    }
+    return distances;
+}
+
+int save_distance_table(const uint8_t* distances, FILE* output_file) {
+    return fwrite(distances, 1, PERM_CNT, output_file) != PERM_CNT;
+}
+
+void free_distance_table(uint8_t* distances) {
+    free(distances);
+}
+
+// REPORT IMPLEMENTATION
+
+void record_expansion(solve_report* report, const board brd, int g, int h) {
+    int f = g + h < REPORT_MAX ? g + h : REPORT_MAX - 1;
+    report->expanded_by_f[f]++;
+    report->expanded_by_g[g < REPORT_MAX ? g : REPORT_MAX - 1]++;
+    if (report->distances == NULL) {
+        return;
+    }
+    // compare the estimate against the true distance, a negative error means h overestimated
+    int error = report->distances[rank_board(brd)] - h;
+    if (report->samples == 0 || error > report->max_error) {
+        report->max_error = error;
+    }
+    if (report->samples == 0 || error < report->min_error) {
+        report->min_error = error;
+    }
+    report->error_sum += error;
+    report->samples++;
+    int bucket = error + REPORT_MAX;
+    report->error_cnt[bucket < 0 ? 0 : bucket >= 2 * REPORT_MAX ? 2 * REPORT_MAX - 1 : bucket]++;
+}
+
+double branching_factor(long expanded, int depth) {
+    // solve expanded + 1 = 1 + b + b^2 + ... + b^depth for b by bisection
+    if (depth <= 0 || expanded <= 0) {
+        return 0;
+    }
+    double lo = 1, hi = (double) expanded + 1;
+    for (int i = 0; i < 100; i++) {
+        double b = (lo + hi) / 2;
+        double nodes = 0, term = 1;
+        for (int d = 0; d <= depth; d++) {
+            nodes += term;
+            term *= b;
+        }
+        if (nodes > (double) expanded + 1) {
+            hi = b;
+        } else {
+            lo = b;
+        }
+    }
+    return (lo + hi) / 2;
+}
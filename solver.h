@@ -0,0 +1,256 @@
+//
+// Joseph Prichard 2023
+//
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "puzzle_api.h"
+
+// every public constant is prefixed, the short names are only defined inside the library
+#define PUZZLE_SIZE 9
+#define PUZZLE_ROWS 3
+#define PUZZLE_LONGEST_SOL 32
+#define PUZZLE_PERM_CNT 362880
+#define PUZZLE_UNREACHABLE 0xFF
+#define PUZZLE_REPORT_MAX 128
+
+PUZZLE_BEGIN_DECLS
+
+// TYPE AND FUNCTION DEFINITIONS
+
+typedef enum move {
+    NONE, UP, DOWN, LEFT, RIGHT
+} move;
+
+typedef enum solve_status {
+    SOLVED, UNSOLVABLE, OUT_OF_MEMORY, INVALID_BOARD, TIMED_OUT, CANCELLED, IN_PROGRESS
+} solve_status;
+
+typedef enum solve_heuristic {
+    MANHATTAN, MISPLACED
+} solve_heuristic;
+
+// instruction sets with a heuristic kernel, in increasing order so each implies the ones before it
+typedef enum solve_isa {
+    ISA_SCALAR, ISA_SSE42, ISA_AVX2, ISA_AVX512
+} solve_isa;
+
+typedef enum solve_algorithm {
+    ASTAR,
+    IDASTAR,
+    TABLE_LOOKUP, // walks a distance table attached with set_solver_table, chosen like AUTO_SELECT without one
+    AUTO_SELECT // the table if there is one, otherwise the search predicted to be cheaper for each board
+} solve_algorithm;
+
+// duplicate pruning at generation time, each level includes the ones before it
+typedef enum solve_pruning {
+    PRUNE_NONE,
+    PRUNE_INVERSE, // never generate the move that undoes the incoming move
+    PRUNE_FSM // IDA* also rejects every move string that a shorter or earlier string is known to reach the same board with
+} solve_pruning;
+
+// how the large structures of a search are backed, from least to most effective at avoiding TLB misses
+typedef enum page_mode {
+    PAGES_DEFAULT, // heap allocated, huge pages weren't requested or nothing was large enough
+    PAGES_SMALL, // huge pages were requested but neither MAP_HUGETLB nor MADV_HUGEPAGE was available
+    PAGES_TRANSPARENT, // advised with MADV_HUGEPAGE, the kernel backs them with huge pages when it can
+    PAGES_HUGETLB // mapped from the reserved huge page pool
+} page_mode;
+
+// scheduling policies of linux, from most to least willing to yield the cpu to other work are idle, batch, other
+typedef enum thread_policy {
+    POLICY_OTHER, POLICY_BATCH, POLICY_IDLE, POLICY_FIFO, POLICY_RR
+} thread_policy;
+
+typedef char tile;
+
+typedef tile board[PUZZLE_SIZE];
+
+typedef struct mem_usage {
+    size_t current;
+    size_t peak;
+} mem_usage;
+
+typedef struct solve_stats {
+    long expanded;
+    long generated;
+    int steps;
+    int f_bound; // f of the last expanded state, a lower bound on the solution length
+    int best_h; // smallest h of any expanded state
+    long allocations;
+    mem_usage puzzles;
+    mem_usage open_set;
+    mem_usage closed_set;
+    mem_usage total;
+    page_mode pages; // weakest mode of any mapping the context has made
+    int numa_node; // node every mapping of the context was bound to, -1 if placement was left to first touch
+    long node_loads; // loads served from memory by any node, -1 if the hardware counters are off or unavailable
+    long remote_loads; // of those, the loads served by another node
+    solve_algorithm algorithm; // the algorithm that ran, AUTO_SELECT resolves to one of the others
+    long predicted; // expansions predicted at the solution's depth for the search that ran, -1 if not predicted
+    double prediction_error; // predicted / expanded - 1
+    mem_usage pruner; // move pruning automaton, kept between solves once built
+} solve_stats;
+
+typedef struct solve_report {
+    const uint8_t* distances; // true distances from the BFS table, NULL skips the error stats
+    long expanded_by_f[PUZZLE_REPORT_MAX];
+    long expanded_by_g[PUZZLE_REPORT_MAX];
+    long error_cnt[2 * PUZZLE_REPORT_MAX]; // indexed by true distance - h, offset by PUZZLE_REPORT_MAX
+    long error_sum;
+    long samples;
+    int max_error;
+    int min_error;
+} solve_report;
+
+// called once per move of a path in forward order with the board after the move, nonzero stops the stream
+typedef int (*move_callback)(move mv, const board brd, void* user);
+
+struct trace_buffer;
+
+// shared with the thread or signal handler that cancels, safe to trip at any time
+typedef struct cancel_token cancel_token;
+
+// owns every structure used by a search and keeps them between solves, one per thread
+typedef struct solver_ctx solver_ctx;
+
+// "major.minor.patch" of the library that was loaded, may differ from the header it was compiled against
+PUZZLE_API const char* puzzle_version();
+
+PUZZLE_API solver_ctx* new_solver(size_t mem_limit);
+
+PUZZLE_API void free_solver(solver_ctx*);
+
+PUZZLE_API void set_solver_trace(solver_ctx*, struct trace_buffer*);
+
+PUZZLE_API void set_solver_report(solver_ctx*, solve_report*);
+
+PUZZLE_API void set_solver_heuristic(solver_ctx*, solve_heuristic);
+
+// IDA* keeps only the current path, so it uses no memory that grows with the search but revisits states
+PUZZLE_API void set_solver_algorithm(solver_ctx*, solve_algorithm);
+
+PUZZLE_API void set_solver_pruning(solver_ctx*, solve_pruning);
+
+// distances to the goal from new_distance_table, owned by the caller. it is only walked for the goal it was built for
+PUZZLE_API void set_solver_table(solver_ctx*, const uint8_t* distances);
+
+PUZZLE_API const char* algorithm_name(solve_algorithm);
+
+PUZZLE_API int parse_algorithm(const char* name, solve_algorithm*);
+
+PUZZLE_API int parse_heuristic(const char* name, solve_heuristic*);
+
+PUZZLE_API int parse_pruning(const char* name, solve_pruning*);
+
+// a context starts with the best kernel the cpu supports, returns 1 if it doesn't support the one forced
+PUZZLE_API int set_solver_isa(solver_ctx*, solve_isa);
+
+PUZZLE_API solve_isa solver_isa(const solver_ctx*);
+
+// backs the node store and large hash tables with 2 MB pages, only between solves, returns 1 if out of memory
+PUZZLE_API int set_solver_huge_pages(solver_ctx*, int enabled);
+
+PUZZLE_API const char* page_mode_name(page_mode);
+
+// nodes of the machine, 1 without NUMA support
+PUZZLE_API int numa_node_cnt();
+
+// node of the cpu the calling thread is running on
+PUZZLE_API int current_numa_node();
+
+// pins the calling thread to the cpus of a node, so the memory it touches first is allocated there, returns 1 on failure
+PUZZLE_API int pin_to_numa_node(int node);
+
+// reads the kernel's cpu list format like "0-3,8", returns how many cpus were written or -1 if it is malformed
+PUZZLE_API int parse_cpus(const char* list, int* out_cpus, int capacity);
+
+// the affinity calls change only the calling thread and return 1 on failure
+PUZZLE_API int pin_to_cpus(const int* cpus, int cnt);
+
+// keeps the calling thread off cpus reserved for others, fails if that leaves it nowhere to run
+PUZZLE_API int pin_away_from_cpus(const int* cpus, int cnt);
+
+// priority is only used by the real time policies, which usually need CAP_SYS_NICE
+PUZZLE_API int set_thread_policy(thread_policy, int priority);
+
+PUZZLE_API int parse_thread_policy(const char* name, thread_policy*);
+
+// maps the node store and large tables bound to a node, -1 leaves them to first touch, only between solves
+PUZZLE_API int set_solver_numa_node(solver_ctx*, int node);
+
+// counts the loads served by local and remote memory while the calling thread solves, returns 1 if unavailable
+PUZZLE_API int set_solver_counters(solver_ctx*, int enabled);
+
+PUZZLE_API solve_isa detect_isa();
+
+PUZZLE_API int isa_supported(solve_isa);
+
+PUZZLE_API const char* isa_name(solve_isa);
+
+PUZZLE_API int parse_isa(const char* name, solve_isa*);
+
+// a solve running longer than timeout_ms returns TIMED_OUT, 0 disables the deadline
+PUZZLE_API void set_solver_timeout(solver_ctx*, long timeout_ms);
+
+PUZZLE_API void set_solver_cancel(solver_ctx*, cancel_token*);
+
+PUZZLE_API cancel_token* new_cancel_token();
+
+PUZZLE_API void cancel_solve(cancel_token*);
+
+PUZZLE_API void free_cancel_token(cancel_token*);
+
+// out_moves must hold PUZZLE_LONGEST_SOL moves, stats->steps of them are written when the board is solved
+PUZZLE_API solve_status solve(solver_ctx*, const board initial_brd, const board goal_brd, move* out_moves, solve_stats*);
+
+// sets up a search that is then driven in slices by step_solve, returns IN_PROGRESS unless it failed outright
+PUZZLE_API solve_status start_solve(solver_ctx*, const board initial_brd, const board goal_brd);
+
+// expands at most max_expansions states, returns IN_PROGRESS until the search has finished
+PUZZLE_API solve_status step_solve(solver_ctx*, long max_expansions);
+
+// copies out the path and stats of the last search, the stats show its progress while it is in progress
+PUZZLE_API solve_status solve_result(const solver_ctx*, move* out_moves, solve_stats*);
+
+// writes the solved path into a caller buffer, returns its length or -1 if unsolved or it doesn't fit
+PUZZLE_API int copy_path(const solver_ctx*, move* out_moves, int capacity);
+
+// streams the solved path through a callback without allocating, returns 1 if unsolved or stopped early
+PUZZLE_API int stream_path(const solver_ctx*, move_callback, void* user);
+
+PUZZLE_API const char* move_name(move);
+
+PUZZLE_API const char* status_name(solve_status);
+
+PUZZLE_API int is_valid_board(const board);
+
+// the heuristic a solve would start from, a lower bound on its length cheap enough to rank boards by, -1 if unsolvable
+PUZZLE_API int estimate_moves(const board brd, const board goal, solve_heuristic);
+
+PUZZLE_API int apply_move(board brd, move mv);
+
+PUZZLE_API int parse_board(board brd, FILE* input_file);
+
+PUZZLE_API int rank_board(const board);
+
+PUZZLE_API void unrank_board(int rank, board);
+
+PUZZLE_API uint8_t* new_distance_table(const board goal);
+
+// tables are PUZZLE_PERM_CNT bytes indexed by rank_board, saved so services don't pay for the BFS on startup
+PUZZLE_API uint8_t* load_distance_table(FILE* input_file);
+
+PUZZLE_API int save_distance_table(const uint8_t* distances, FILE* output_file);
+
+PUZZLE_API void free_distance_table(uint8_t* distances);
+
+PUZZLE_API double branching_factor(long expanded, int depth);
+
+PUZZLE_END_DECLS
+
+#endif
@@ -0,0 +1,408 @@
+//
+// Joseph Prichard 2023
+//
+
+#ifndef SOLVER_INTERNAL_H
+#define SOLVER_INTERNAL_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+#include "solver.h"
+#include "trace.h"
+
+#define SIZE PUZZLE_SIZE
+#define ROWS PUZZLE_ROWS
+#define LONGEST_SOL PUZZLE_LONGEST_SOL
+#define PERM_CNT PUZZLE_PERM_CNT
+#define UNREACHABLE PUZZLE_UNREACHABLE
+#define REPORT_MAX PUZZLE_REPORT_MAX
+#define NEIGHBOR_CNT 4
+#define CHILD_CNT 4
+#define LF_THRESHOLD 0.7f
+#define TRACE_SAMPLE_MASK 1023
+#define TRACE_CAPACITY 4096
+#define TRACE_MAX_THREADS 64
+#define TRACE_DRAIN_NS 1000000
+#define NODE_INITIAL_CAP 4096
+#define NODE_SIZE (sizeof(uint64_t) + sizeof(int) + 3)
+#define TILE_BITS 4
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define CANCEL_CHECK_MASK 1023
+#define ISA_CNT 4
+#define FSM_DEPTH 10
+#define FSM_PRUNE -1
+#define FSM_ILLEGAL -2
+#define NUMA_MASK_WORDS 16
+#define COUNTER_CNT 2
+#define POLICY_CNT 5
+#define ALGORITHM_CNT 4
+#define HEURISTIC_CNT 2
+#define PRUNING_CNT 3
+#define HDIST_SAMPLES 16384
+#define HDIST_SEED 0x9E3779B97F4A7C15ULL
+// measured relative cost of an expansion, an A* one pays for the heap and the closed set
+#define IDA_NODE_COST 1
+#define ASTAR_NODE_COST 9
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS
+#endif
+
+// TYPE AND FUNCTION DEFINITIONS
+
+typedef struct trace_event {
+    const char* name;
+    const char* arg;
+    long value;
+    double ts;
+    char phase;
+} trace_event;
+
+// single producer ring, only the owning thread pushes and only the drain pops
+struct trace_buffer {
+    trace_event events[TRACE_CAPACITY];
+    atomic_size_t head;
+    atomic_size_t tail;
+    atomic_long dropped;
+    int open_spans; // accepted begins without their end yet, each keeps a slot reserved for it
+    int dropped_spans; // dropped begins without their end yet, the ends are dropped too so spans stay balanced
+    int tid;
+    struct trace_writer* writer;
+};
+
+// a drain thread owned by the writer empties the rings into the file, producers never touch the file
+struct trace_writer {
+    FILE* out;
+    double start_ns;
+    long event_cnt;
+    pthread_mutex_t drain_lock;
+    pthread_t drainer;
+    atomic_int running;
+    atomic_int buffer_cnt;
+    _Atomic(trace_buffer*) buffers[TRACE_MAX_THREADS];
+};
+
+typedef struct mem_budget {
+    mem_usage total;
+    size_t limit; // 0 means unlimited
+    long allocations; // calls into the allocator, a warm context makes none
+    int huge_pages; // large structures are mapped with huge pages instead of the heap
+    page_mode pages;
+    int numa_node; // every structure is mapped and bound to this node, -1 leaves them to first touch
+    int numa_failed; // a mapping couldn't be bound
+} mem_budget;
+
+// the heap carries f next to each node, so sifting never reads the node store
+typedef struct pq_entry {
+    int f;
+    int node;
+} pq_entry;
+
+typedef struct priority_q {
+    pq_entry* min_heap;
+    int size;
+    int capacity;
+    size_t mapped; // length of the mapping the heap came from, 0 if it came from the heap
+    mem_usage mem;
+    mem_budget* budget;
+} priority_q;
+
+// a slot is occupied only if its generation is the table's current one
+typedef struct ht_slot {
+    int key;
+    unsigned int generation;
+} ht_slot;
+
+typedef struct hash_table {
+    ht_slot* table;
+    int size;
+    int capacity;
+    unsigned int generation;
+    size_t mapped; // length of the mapping the table came from, 0 if it came from the heap
+    mem_usage mem;
+    mem_budget* budget;
+} hash_table;
+
+// every generated state as a column per field in one block kept between solves, nodes are addressed by index
+typedef struct node_store {
+    uint64_t* boards; // TILE_BITS per tile, first tile in the low bits
+    int* parents; // -1 for the root
+    uint8_t* g;
+    uint8_t* h;
+    uint8_t* moves;
+    int size;
+    int capacity;
+    size_t mapped; // length of the mapping the block came from, 0 if it came from the heap
+    mem_usage mem;
+    mem_budget* budget;
+} node_store;
+
+// goal row and column of each tile, padded to a vector so a kernel can look them up with one shuffle. the columns
+// directly follow the rows, so the AVX2 kernel loads both as one 256-bit vector
+typedef struct goal_lanes {
+    _Alignas(16) uint8_t rows[16];
+    _Alignas(16) uint8_t cols[16];
+} goal_lanes;
+
+typedef int (*heuristic_kernel)(const board, const goal_lanes*);
+
+// aho-corasick automaton over the moves of the blank, a transition to FSM_PRUNE completes a duplicate move string
+typedef struct fsm {
+    int (*next)[NEIGHBOR_CNT];
+    int node_cnt;
+    int node_cap;
+    int roots[SIZE]; // the empty string with the blank at each position
+    mem_usage mem;
+} fsm;
+
+typedef struct ida_frame {
+    board board;
+    move move;
+    int g;
+    int h;
+    int next; // index of the next neighbor to generate
+    int state; // state of the fsm after the moves to this node
+} ida_frame;
+
+// the path of the depth first search in progress, kept so it can be resumed by step_solve
+typedef struct ida_search {
+    ida_frame stack[LONGEST_SOL + 1];
+    int depth;
+    int bound;
+    int next_bound; // smallest f that exceeded the bound in this iteration
+} ida_search;
+
+struct cancel_token {
+    atomic_int cancelled;
+};
+
+struct solver_ctx {
+    mem_budget budget;
+    node_store* nodes;
+    priority_q* open_set;
+    hash_table* closed_set;
+    int goal_index[SIZE]; // position of each tile on the goal board
+    goal_lanes lanes;
+    trace_buffer* trace;
+    solve_report* report;
+    long timeout_ms;
+    cancel_token* cancel;
+    solve_heuristic heuristic;
+    solve_isa isa;
+    solve_algorithm algorithm;
+    solve_pruning pruning;
+    fsm* pruner; // built by the first IDA* search or prediction that needs it
+    const uint8_t* table;
+    // inputs of the tree size predictions, kept between solves since they only change with the goal or the options
+    // chance a child of a state with each h has h - 1, h or h + 1, one move changes either heuristic by at most 1
+    double h_next[LONGEST_SOL + 1][3];
+    int h_dist_goal; // hash of the goal h_next was sampled for
+    int h_dist_heuristic; // heuristic h_next was sampled with, -1 before the first sample
+    double tree_sizes[SIZE][LONGEST_SOL + 1]; // nodes at each depth of the pruned brute force tree, by blank position
+    int tree_pruning[SIZE]; // pruning tree_sizes were counted with, -1 before the first count
+    double graph_sizes[SIZE][LONGEST_SOL + 1]; // the same under fsm pruning, closest to the distinct states A* expands
+    char graph_counted[SIZE];
+    int counters[COUNTER_CNT]; // perf event descriptors of the node load counters, -1 when they are off
+    // state of the search in progress, kept here so it can be resumed by step_solve
+    solve_algorithm active; // the algorithm running, AUTO_SELECT resolves to one of the others
+    long switch_expanded; // expansions of IDA* before AUTO_SELECT moved the search to A*
+    solve_status status;
+    solve_stats stats;
+    int goal_hash;
+    int f_layer;
+    long allocations;
+    double deadline;
+    board initial;
+    board goal;
+    move path[LONGEST_SOL];
+    ida_search ida;
+};
+
+void reset_peak(mem_usage*);
+
+void update_usage(mem_usage*, size_t old_size, size_t new_size);
+
+void* realloc_tracked(void* ptr, size_t old_size, size_t new_size, mem_usage*, mem_budget*);
+
+void free_tracked(void* ptr, size_t size, mem_usage*, mem_budget*);
+
+int use_huge_pages(const mem_budget*, size_t size);
+
+int use_mapping(const mem_budget*, size_t size);
+
+size_t huge_page_round(size_t size);
+
+size_t mapping_size(const mem_budget*, size_t size);
+
+void* alloc_pages(size_t size, size_t* mapped, mem_usage*, mem_budget*);
+
+void free_pages(void* ptr, size_t size, size_t mapped, mem_usage*, mem_budget*);
+
+void* map_pages(size_t size, mem_usage*, mem_budget*);
+
+void unmap_pages(void* ptr, size_t size, mem_usage*, mem_budget*);
+
+int bind_pages(void* ptr, size_t size, int node);
+
+int open_counter(int result);
+
+int open_counters(int* fds);
+
+void start_counters(const int* fds);
+
+void read_counters(const int* fds, long* node_loads, long* remote_loads);
+
+void close_counters(int* fds);
+
+// only translation units built with _GNU_SOURCE see cpu sets
+#ifdef CPU_SETSIZE
+int parse_cpu_list(const char* list, cpu_set_t*);
+#endif
+
+node_store* new_nodes(mem_budget*);
+
+void place_columns(node_store*, char* block, int capacity);
+
+int grow_nodes(node_store*);
+
+int new_node(node_store*, const board, int parent, int g, int h, move);
+
+void clear_nodes(node_store*);
+
+void free_nodes(node_store*);
+
+uint64_t pack_board(const board);
+
+void unpack_board(uint64_t packed, board);
+
+hash_table* new_ht(mem_budget*);
+
+int hash_board(const board);
+
+int rehash(hash_table*);
+
+int probe(hash_table*, int, int);
+
+int insert_into_ht(hash_table* ht, int key);
+
+void probe_ht(hash_table* ht, int key);
+
+int ht_has_key(hash_table* ht, int key);
+
+void prefetch_ht(hash_table* ht, int key);
+
+int is_prime(int);
+
+int next_prime(int);
+
+void clear_ht(hash_table*);
+
+void free_ht(hash_table*);
+
+priority_q* new_pq(mem_budget*);
+
+int ensure_capacity(priority_q*);
+
+int push_pq(priority_q*, int node, int f);
+
+int pop_pq(priority_q*);
+
+void clear_pq(priority_q*);
+
+void free_pq(priority_q*);
+
+int find_zero(const board);
+
+int move_board(const board brd_in, board brd_out, int row_offset, int col_offset);
+
+void index_goal(const board goal, int* goal_index);
+
+int heuristic(const board, const int* goal_index);
+
+int misplaced_tiles(const board, const int* goal_index);
+
+int estimate(const solver_ctx*, const board);
+
+solve_status step_manhattan(solver_ctx*, long max_expansions);
+
+solve_status step_manhattan_sse42(solver_ctx*, long max_expansions);
+
+solve_status step_manhattan_avx2(solver_ctx*, long max_expansions);
+
+solve_status step_manhattan_avx512(solver_ctx*, long max_expansions);
+
+solve_status step_misplaced(solver_ctx*, long max_expansions);
+
+int is_solvable(const board initial_brd, const board goal_brd);
+
+fsm* new_fsm(mem_budget*);
+
+int grow_fsm(fsm*, mem_budget*);
+
+int add_fsm_node(fsm*, mem_budget*, board** boards, int** depths, const board, int depth);
+
+int build_fsm(fsm*, mem_budget*);
+
+void free_fsm(fsm*, mem_budget*);
+
+solve_status start_ida(solver_ctx*);
+
+solve_status step_ida(solver_ctx*, long max_expansions);
+
+solve_status start_astar(solver_ctx*);
+
+uint64_t next_random(uint64_t* state);
+
+void sample_heuristic(solver_ctx*);
+
+void count_move_tree(int blank, int prune_inverse, double* sizes);
+
+int count_fsm_tree(const fsm*, int blank, double* sizes);
+
+int count_tree(solver_ctx*, int blank);
+
+double predict_iteration(const solver_ctx*, const double* sizes, int h, int threshold);
+
+double predict_ida(const solver_ctx*, int blank, int h, int depth);
+
+double predict_astar(const solver_ctx*, int blank, int h, int depth);
+
+int prefer_astar(const solver_ctx*, int threshold);
+
+int has_table(const solver_ctx*);
+
+solve_algorithm select_algorithm(solver_ctx*);
+
+solve_status walk_table(solver_ctx*);
+
+void record_prediction(solver_ctx*);
+
+int rebuild_structures(solver_ctx*);
+
+solve_status poll_cancel(solver_ctx*, double deadline);
+
+void finish_solve(solver_ctx*);
+
+heuristic_kernel kernel_for(solve_isa);
+
+void index_lanes(const int* goal_index, goal_lanes*);
+
+int manhattan_scalar(const board, const goal_lanes*);
+
+int manhattan_sse42(const board, const goal_lanes*);
+
+int manhattan_avx2(const board, const goal_lanes*);
+
+int manhattan_avx512(const board, const goal_lanes*);
+
+void record_expansion(solve_report*, const board, int g, int h);
+
+void reconstruct_path(const node_store*, int leaf, int steps, move* out_moves);
+
+// GLOBALS
+
+static const int NEIGHBOR_OFFSETS[NEIGHBOR_CNT][2] = {{0, 1}, {1, 0}, {0, -1}, {-1, 0}};
+static const int NEIGHBOR_MOVES[NEIGHBOR_CNT] = {RIGHT, DOWN, LEFT, UP};
+static const int INVERSE_MOVES[] = {NONE, DOWN, UP, RIGHT, LEFT};
+
+#endif
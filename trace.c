@@ -0,0 +1,183 @@
+//
+// Joseph Prichard 2023
+//
+
+#include <stdlib.h>
+#include <time.h>
+#include "solver_internal.h"
+
+// TRACE IMPLEMENTATION
+
+double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static void* drain_loop(void* arg) {
+    trace_writer* tw = arg;
+    struct timespec interval = {0, TRACE_DRAIN_NS};
+    while (atomic_load_explicit(&tw->running, memory_order_acquire)) {
+        drain_trace(tw);
+        nanosleep(&interval, NULL);
+    }
+    return NULL;
+}
+
+trace_writer* open_trace(const char* path) {
+    trace_writer* tw = malloc(sizeof(trace_writer));
+    if (tw == NULL) {
+        return NULL;
+    }
+    tw->out = fopen(path, "w");
+    if (tw->out == NULL) {
+        free(tw);
+        return NULL;
+    }
+    tw->start_ns = now_ns();
+    tw->event_cnt = 0;
+    pthread_mutex_init(&tw->drain_lock, NULL);
+    atomic_init(&tw->buffer_cnt, 0);
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        atomic_init(&tw->buffers[i], NULL);
+    }
+    fprintf(tw->out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    atomic_init(&tw->running, 1);
+    if (pthread_create(&tw->drainer, NULL, drain_loop, tw) != 0) {
+        fclose(tw->out);
+        pthread_mutex_destroy(&tw->drain_lock);
+        free(tw);
+        return NULL;
+    }
+    return tw;
+}
+
+trace_buffer* trace_thread(trace_writer* tw, int tid) {
+    // each thread registers its own buffer so pushing an event never takes a lock
+    if (tw == NULL) {
+        return NULL;
+    }
+    int slot = atomic_fetch_add(&tw->buffer_cnt, 1);
+    if (slot >= TRACE_MAX_THREADS) {
+        return NULL;
+    }
+    trace_buffer* tb = malloc(sizeof(trace_buffer));
+    if (tb == NULL) {
+        return NULL;
+    }
+    atomic_init(&tb->head, 0);
+    atomic_init(&tb->tail, 0);
+    atomic_init(&tb->dropped, 0);
+    tb->open_spans = 0;
+    tb->dropped_spans = 0;
+    tb->tid = tid;
+    tb->writer = tw;
+    atomic_store_explicit(&tw->buffers[slot], tb, memory_order_release);
+    return tb;
+}
+
+void push_trace(trace_buffer* tb, char phase, const char* name, const char* arg, long value) {
+    size_t head = atomic_load_explicit(&tb->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&tb->tail, memory_order_acquire);
+    // the producer never waits for the drain thread, an event that doesn't fit is counted and dropped. spans are kept
+    // or dropped whole: a begin also needs room for its end, and an end inside a dropped span is dropped with it
+    size_t used = head - tail + (size_t) tb->open_spans;
+    int fits;
+    if (phase == 'E') {
+        fits = tb->dropped_spans == 0;
+        tb->dropped_spans -= !fits;
+        tb->open_spans -= fits;
+    } else if (phase == 'B') {
+        fits = tb->dropped_spans == 0 && used + 2 <= TRACE_CAPACITY;
+        tb->dropped_spans += !fits;
+        tb->open_spans += fits;
+    } else {
+        fits = used < TRACE_CAPACITY;
+    }
+    if (!fits) {
+        atomic_fetch_add_explicit(&tb->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    trace_event* ev = &tb->events[head & (TRACE_CAPACITY - 1)];
+    ev->phase = phase;
+    ev->name = name;
+    ev->arg = arg;
+    ev->value = value;
+    ev->ts = now_ns();
+    // publish the event only after it is fully written
+    atomic_store_explicit(&tb->head, head + 1, memory_order_release);
+}
+
+void trace_begin(trace_buffer* tb, const char* name) {
+    if (tb != NULL) {
+        push_trace(tb, 'B', name, NULL, 0);
+    }
+}
+
+void trace_end(trace_buffer* tb, const char* name) {
+    if (tb != NULL) {
+        push_trace(tb, 'E', name, NULL, 0);
+    }
+}
+
+void trace_counter(trace_buffer* tb, const char* name, long value) {
+    if (tb != NULL) {
+        push_trace(tb, 'C', name, "size", value);
+    }
+}
+
+void trace_instant(trace_buffer* tb, const char* name, const char* arg, long value) {
+    if (tb != NULL) {
+        push_trace(tb, 'i', name, arg, value);
+    }
+}
+
+void drain_trace(trace_writer* tw) {
+    // the lock serializes the drain thread with explicit drains, producers keep pushing while the file is written
+    pthread_mutex_lock(&tw->drain_lock);
+    int buffer_cnt = atomic_load(&tw->buffer_cnt);
+    for (int i = 0; i < buffer_cnt && i < TRACE_MAX_THREADS; i++) {
+        trace_buffer* tb = atomic_load_explicit(&tw->buffers[i], memory_order_acquire);
+        if (tb == NULL) {
+            continue;
+        }
+        size_t tail = atomic_load_explicit(&tb->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&tb->head, memory_order_acquire);
+        for (; tail != head; tail++) {
+            trace_event* ev = &tb->events[tail & (TRACE_CAPACITY - 1)];
+            fprintf(tw->out, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d",
+                    tw->event_cnt == 0 ? "" : ",", ev->name, ev->phase, (ev->ts - tw->start_ns) / 1000.0, tb->tid);
+            if (ev->phase == 'i') {
+                fprintf(tw->out, ",\"s\":\"t\"");
+            }
+            if (ev->arg != NULL) {
+                fprintf(tw->out, ",\"args\":{\"%s\":%ld}", ev->arg, ev->value);
+            }
+            fprintf(tw->out, "}");
+            tw->event_cnt++;
+        }
+        atomic_store_explicit(&tb->tail, tail, memory_order_release);
+    }
+    pthread_mutex_unlock(&tw->drain_lock);
+}
+
+long close_trace(trace_writer* tw) {
+    // all producers must have finished before the buffers are released
+    atomic_store_explicit(&tw->running, 0, memory_order_release);
+    pthread_join(tw->drainer, NULL);
+    drain_trace(tw);
+    fprintf(tw->out, "\n]}\n");
+    fclose(tw->out);
+    long dropped = 0;
+    int buffer_cnt = atomic_load(&tw->buffer_cnt);
+    for (int i = 0; i < buffer_cnt && i < TRACE_MAX_THREADS; i++) {
+        trace_buffer* tb = atomic_load(&tw->buffers[i]);
+        if (tb != NULL) {
+            dropped += atomic_load(&tb->dropped);
+            free(tb);
+        }
+    }
+    pthread_mutex_destroy(&tw->drain_lock);
+    free(tw);
+    return dropped;
+}
@@ -0,0 +1,43 @@
+//
+// Joseph Prichard 2023
+//
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "puzzle_api.h"
+
+PUZZLE_BEGIN_DECLS
+
+// TYPE AND FUNCTION DEFINITIONS
+
+// defined inside the library, so the header has no C11 atomics and can be included from C++
+typedef struct trace_buffer trace_buffer;
+
+typedef struct trace_writer trace_writer;
+
+PUZZLE_API double now_ns();
+
+PUZZLE_API trace_writer* open_trace(const char* path);
+
+PUZZLE_API trace_buffer* trace_thread(trace_writer*, int tid);
+
+PUZZLE_API void push_trace(trace_buffer*, char phase, const char* name, const char* arg, long value);
+
+PUZZLE_API void trace_begin(trace_buffer*, const char* name);
+
+PUZZLE_API void trace_end(trace_buffer*, const char* name);
+
+PUZZLE_API void trace_counter(trace_buffer*, const char* name, long value);
+
+PUZZLE_API void trace_instant(trace_buffer*, const char* name, const char* arg, long value);
+
+// writes every event pushed so far, safe to call while producers keep pushing
+PUZZLE_API void drain_trace(trace_writer*);
+
+// stops the drain thread and writes the remaining events, returns the number of events dropped on full rings
+PUZZLE_API long close_trace(trace_writer*);
+
+PUZZLE_END_DECLS
+
+#endif
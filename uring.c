@@ -0,0 +1,183 @@
+//
+// Joseph Prichard 2023
+//
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "uring.h"
+
+#ifdef HAVE_URING
+#include <linux/io_uring.h>
+#endif
+
+// RING IMPLEMENTATION
+
+#ifdef HAVE_URING
+
+int init_uring(uring* ring, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(uring));
+    ring->fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        return 1;
+    }
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    // newer kernels map both rings with one mapping
+    int single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) {
+        ring->sq_size = ring->sq_size > ring->cq_size ? ring->sq_size : ring->cq_size;
+        ring->cq_size = ring->sq_size;
+    }
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                        IORING_OFF_SQ_RING);
+    ring->cq_ptr = single || ring->sq_ptr == MAP_FAILED
+        ? ring->sq_ptr
+        : mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                      IORING_OFF_SQES);
+    if (ring->sq_ptr == MAP_FAILED || ring->cq_ptr == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        free_uring(ring);
+        return 1;
+    }
+    char* sq = ring->sq_ptr;
+    ring->sq_head = (unsigned*) (sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*) (sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*) (sq + params.sq_off.array);
+    ring->sq_entries = params.sq_entries;
+    ring->sqe_tail = *ring->sq_tail;
+    char* cq = ring->cq_ptr;
+    ring->cq_head = (unsigned*) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+    return 0;
+}
+
+int register_buffers(uring* ring, const struct iovec* iovecs, unsigned cnt) {
+    // the kernel pins registered buffers once, so fixed reads and writes skip mapping them on every request
+    return syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, iovecs, cnt) != 0;
+}
+
+int queue_fixed(uring* ring, int write, int fd, void* buf, unsigned len, long long offset, int buf_index,
+                unsigned long long user_data) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sqe_tail - head >= ring->sq_entries) {
+        return 1;
+    }
+    unsigned index = ring->sqe_tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long) buf;
+    sqe->len = len;
+    sqe->off = (unsigned long long) offset;
+    sqe->buf_index = (unsigned short) buf_index;
+    sqe->user_data = user_data;
+    ring->sq_array[index] = index;
+    ring->sqe_tail++;
+    return 0;
+}
+
+int enter_uring(uring* ring, unsigned wait_nr) {
+    // publish the queued entries, the release store makes their contents visible before the tail
+    __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+    for (;;) {
+        // the kernel advances the head past every entry it consumed, so whatever is left after a partial submission
+        // or an interrupted wait is submitted again
+        unsigned to_submit = ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        long n = syscall(__NR_io_uring_enter, ring->fd, to_submit, wait_nr, wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0,
+                         NULL, 0);
+        if (n < 0 && errno != EINTR) {
+            return 1;
+        }
+        if (n == (long) to_submit) {
+            return 0;
+        }
+        // retrying an entry the kernel neither consumed nor failed would spin forever
+        if (n == 0) {
+            return 1;
+        }
+    }
+}
+
+int pop_completion(uring* ring, uring_completion* out) {
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        return 1;
+    }
+    const struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+    out->user_data = cqe->user_data;
+    out->res = cqe->res;
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void free_uring(uring* ring) {
+    if (ring->sqes != NULL && ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ptr != NULL && ring->cq_ptr != MAP_FAILED && ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_size);
+    }
+    if (ring->sq_ptr != NULL && ring->sq_ptr != MAP_FAILED) {
+        munmap(ring->sq_ptr, ring->sq_size);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    ring->fd = -1;
+}
+
+#else
+
+int init_uring(uring* ring, unsigned entries) {
+    (void) entries;
+    ring->fd = -1;
+    return 1;
+}
+
+int register_buffers(uring* ring, const struct iovec* iovecs, unsigned cnt) {
+    (void) ring;
+    (void) iovecs;
+    (void) cnt;
+    return 1;
+}
+
+int queue_fixed(uring* ring, int write, int fd, void* buf, unsigned len, long long offset, int buf_index,
+                unsigned long long user_data) {
+    (void) ring;
+    (void) write;
+    (void) fd;
+    (void) buf;
+    (void) len;
+    (void) offset;
+    (void) buf_index;
+    (void) user_data;
+    return 1;
+}
+
+int enter_uring(uring* ring, unsigned wait_nr) {
+    (void) ring;
+    (void) wait_nr;
+    return 1;
+}
+
+int pop_completion(uring* ring, uring_completion* out) {
+    (void) ring;
+    (void) out;
+    return 1;
+}
+
+void free_uring(uring* ring) {
+    (void) ring;
+}
+
+#endif
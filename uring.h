@@ -0,0 +1,68 @@
+//
+// Joseph Prichard 2023
+//
+
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_URING
+#endif
+#endif
+
+#define URING_ENTRIES 16
+
+// TYPE AND FUNCTION DEFINITIONS
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// an io_uring set up with raw system calls, the rings are shared with the kernel so the heads and tails are atomic
+typedef struct uring {
+    int fd;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned sq_entries;
+    unsigned sqe_tail; // entries handed out, published to the kernel on the next enter
+    struct io_uring_sqe* sqes;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    void* sq_ptr;
+    size_t sq_size;
+    void* cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+} uring;
+
+// a completion copied out of the ring
+typedef struct uring_completion {
+    unsigned long long user_data;
+    int res;
+} uring_completion;
+
+// returns 1 if io_uring isn't supported by the kernel or the build, or is disabled by policy
+int init_uring(uring*, unsigned entries);
+
+int register_buffers(uring*, const struct iovec*, unsigned cnt);
+
+// queues a read or write of a registered buffer, returns 1 if the submission ring is full
+int queue_fixed(uring*, int write, int fd, void* buf, unsigned len, long long offset, int buf_index,
+                unsigned long long user_data);
+
+// submits everything queued and waits for at least wait_nr completions, returns 1 if an entry couldn't be submitted
+int enter_uring(uring*, unsigned wait_nr);
+
+// returns 1 if no completion is ready
+int pop_completion(uring*, uring_completion*);
+
+void free_uring(uring*);
+
+#endif